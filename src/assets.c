@@ -35,10 +35,12 @@
 #include "player.h"
 #include "palette.h"
 #include "character.h"
+#include "render_gl.h"
 
 FILE *yodesk_fileptr;
 long yodesk_size = 0;
 void *yodesk_data;
+u32 yodesk_hash = 0;
 
 float ASSETS_PERCENT = 0.0f;
 u8 ASSETS_LOADING = 1;
@@ -49,6 +51,7 @@ u32* tile;
 char **sound_files;
 
 void *texture_buffers[0x2001];
+blit_spans *texture_spans[0x2001];
 #ifdef RENDER_GL
     GLuint texture[0x2001];
 #endif
@@ -74,6 +77,27 @@ extern u8 *yodesk_bin;
 extern u32 yodesk_bin_size;
 #endif
 
+//FNV-1a over the whole DAT, used to tie save states to the data they were made against
+u32 hash_dat()
+{
+    u32 hash = 0x811C9DC5;
+#ifndef DAT_IN_RAM
+    u8 buffer[0x1000];
+    size_t read;
+
+    rewind(yodesk_fileptr);
+    while((read = fread(buffer, sizeof(u8), sizeof(buffer), yodesk_fileptr)) > 0)
+    {
+        for(size_t i = 0; i < read; i++)
+            hash = (hash ^ buffer[i]) * 0x01000193;
+    }
+#else
+    for(long i = 0; i < yodesk_size; i++)
+        hash = (hash ^ ((u8*)yodesk_data)[i]) * 0x01000193;
+#endif
+    return hash;
+}
+
 bool load_resources()
 {
     char *file_to_load = is_yoda ? (load_demo ? "YodaDemo.dta" : "YODESK.DTA") : "DESKTOP.DAW";
@@ -102,6 +126,7 @@ bool load_resources()
 #endif
 #endif
     log("%s loaded, %lx bytes large\n", file_to_load, yodesk_size);
+    yodesk_hash = hash_dat();
 
     u16 izon_count = 0;
     u8 found = 1;
@@ -351,6 +376,9 @@ bool load_resources()
                 u32 tile_stuff = read_long();
                 tile_metadata[j] = tile_stuff;
                 load_texture(32, get_location(), j);
+
+                //Tiles are kept as palette indices, so the mask comes straight from them
+                tile_palette_anim[j] = palette_anim_mask(texture_buffers[j], 32*32);
                 seek_add(32*32*sizeof(u8));
             }
             seek(tag_seek+section_length+0x8);
@@ -414,11 +442,17 @@ bool load_resources()
             u32 size = read_long();
             log("Found CHAR at %x, size %x\n", tag_seek, size);
 
-            char_data = malloc((size / (is_yoda ? 0x54 : 0x4E)) * sizeof(char*));
+            char_count = size / (is_yoda ? 0x54 : 0x4E);
+            char_data = calloc(char_count, sizeof(char*));
 
-            for(int j = 0; j < (size / (is_yoda ? 0x54 : 0x4E)); j++)
+            for(int j = 0; j < char_count; j++)
             {
                 u16 id = read_short();
+                if(id >= char_count)
+                {
+                    seek_add((is_yoda ? 0x54 : 0x4E) - 2);
+                    continue;
+                }
 
                 ichr_data *new_entry = malloc(sizeof(ichr_data));
 
@@ -582,6 +616,19 @@ void load_texture(u16 width, u32 data_loc, u32 texture_num)
     seek(data_loc);
 
 #ifdef RENDER_GL
+    //Tiles stay as indices either way, without the palette shader they're baked to RGBA as they're uploaded
+    if(width == 32)
+    {
+        u8 *indices = malloc((size_t)(width * width * sizeof(u8)));
+        read_bytes(indices, (size_t)(width * width * sizeof(u8)));
+        texture_buffers[texture_num] = indices;
+
+        render_gl_init_palette();
+        render_gl_upload_tile(texture_num, indices);
+        seek(orig_seek);
+        return;
+    }
+
     u32 *data_buffer = malloc((size_t)(width * width * 4));
     texture_buffers[texture_num] = data_buffer;
     int index = 0;
@@ -597,9 +644,11 @@ void load_texture(u16 width, u32 data_loc, u32 texture_num)
         if(color_index != 0)
             color |= 0xFF000000; //Make sure it's not transparent
 
+        //The startup image is still drawn flipped
         data_buffer[(width * width) - i - 1] = color;
         index++;
     }
+
     glGenTextures(0x1, &texture[texture_num]);
     glBindTexture( GL_TEXTURE_2D, texture[texture_num]);
     glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, width, width, 0, GL_RGBA, GL_UNSIGNED_BYTE, data_buffer);
@@ -612,6 +661,9 @@ void load_texture(u16 width, u32 data_loc, u32 texture_num)
     void *data_buffer = malloc((size_t)(width * width * sizeof(u8)));
     read_bytes(data_buffer, (size_t)(width * width * sizeof(u8)));
     texture_buffers[texture_num] = data_buffer;
+
+    if(width == 32)
+        texture_spans[texture_num] = blit_spans_build(data_buffer);
 #endif
 
     seek(orig_seek);
@@ -739,3 +791,39 @@ void read_bytes(void *out, size_t size)
     memcpy(out, yodesk_data+yodesk_seek, size);
 #endif
 }
+
+//Reads at an absolute location without disturbing the seek position, so
+//the DAT can be consulted directly while a script is being walked.
+u32 peek_long(u32 location)
+{
+    u32 value;
+#ifndef DAT_IN_RAM
+    fseek(yodesk_fileptr, location, SEEK_SET);
+    fread(&value, sizeof(u32), 1, yodesk_fileptr);
+#else
+    value = *(u32*)(yodesk_data+location);
+#endif
+
+#if BIG_ENDIAN && !LITTLE_ENDIAN
+    value = (value >> 24) | ((value & 0xFF0000) >> 8) | ((value & 0xFF00) << 8) | (value << 24);
+#endif
+
+    return value;
+}
+
+u16 peek_short(u32 location)
+{
+    u16 value;
+#ifndef DAT_IN_RAM
+    fseek(yodesk_fileptr, location, SEEK_SET);
+    fread(&value, sizeof(u16), 1, yodesk_fileptr);
+#else
+    value = *(u16*)(yodesk_data+location);
+#endif
+
+#if BIG_ENDIAN && !LITTLE_ENDIAN
+    value = (u16)((value & 0xFF00) >> 8) | ((value & 0xFF) << 8);
+#endif
+
+    return value;
+}
@@ -0,0 +1,132 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+//Times the row kernels against the per-pixel loops over a 32x32 tile workload
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "blit.h"
+
+#define BENCH_TILE 32
+#define BENCH_TILES (18 * 18)
+#define BENCH_FRAMES 2000
+#define BENCH_OVERLAY_ALPHA 153
+
+static u32 bench_lut[0x100];
+static u8 bench_tiles[BENCH_TILES][BENCH_TILE * BENCH_TILE];
+static u32 bench_dst[BENCH_TILE * BENCH_TILE];
+static u8 bench_dst_indexed[BENCH_TILE * BENCH_TILE];
+
+static double bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static void bench_report(const char *name, double scalar, double vector)
+{
+    double pixels = (double)BENCH_FRAMES * BENCH_TILES * BENCH_TILE * BENCH_TILE;
+    printf("%-8s scalar %7.2f Mpx/s  %s %7.2f Mpx/s  x%.2f\n", name, pixels / scalar / 1e6, blit_kernel_name, pixels / vector / 1e6, scalar / vector);
+}
+
+#define BENCH_RUN(result, call) \
+    do { \
+        double start = bench_now(); \
+        for(int frame = 0; frame < BENCH_FRAMES; frame++) \
+            for(int tile = 0; tile < BENCH_TILES; tile++) \
+                for(int row = 0; row < BENCH_TILE; row++) \
+                    call; \
+        result = bench_now() - start; \
+    } while(0)
+
+int main(int argc, char **argv)
+{
+    srand(0x5941);
+    for(int i = 0; i < 0x100; i++)
+        bench_lut[i] = 0xFF000000 | (rand() & 0xFFFFFF);
+
+    //Roughly a third of each tile transparent, like typical object tiles
+    for(int t = 0; t < BENCH_TILES; t++)
+        for(int i = 0; i < BENCH_TILE * BENCH_TILE; i++)
+            bench_tiles[t][i] = (rand() % 3) ? (rand() & 0xFF) : 0;
+
+    //Check the kernels agree with the scalar loops before timing them
+    u32 check[BENCH_TILE * BENCH_TILE];
+    u8 check_indexed[BENCH_TILE * BENCH_TILE];
+    for(int t = 0; t < BENCH_TILES; t++)
+    {
+        u8 *src = bench_tiles[t];
+        u8 *under = bench_tiles[(t + 1) % BENCH_TILES];
+
+        blit_expand_row_scalar(bench_dst, under, BENCH_TILE * BENCH_TILE, bench_lut);
+        memcpy(check, bench_dst, sizeof(check));
+        blit_blend_row_scalar(check, src, BENCH_TILE * BENCH_TILE - t % 7, bench_lut, BENCH_OVERLAY_ALPHA);
+        blit_blend_row(bench_dst, src, BENCH_TILE * BENCH_TILE - t % 7, bench_lut, BENCH_OVERLAY_ALPHA);
+        if(memcmp(check, bench_dst, sizeof(check)))
+        {
+            printf("blend mismatch on tile %i\n", t);
+            return 1;
+        }
+
+        blit_masked_row_scalar(check, src, BENCH_TILE * BENCH_TILE - t % 5, bench_lut);
+        blit_masked_row(bench_dst, src, BENCH_TILE * BENCH_TILE - t % 5, bench_lut);
+        if(memcmp(check, bench_dst, sizeof(check)))
+        {
+            printf("masked mismatch on tile %i\n", t);
+            return 1;
+        }
+
+        memcpy(check_indexed, under, sizeof(check_indexed));
+        memcpy(bench_dst_indexed, under, sizeof(check_indexed));
+        blit_compose_row_scalar(check_indexed, src, BENCH_TILE * BENCH_TILE - t % 3);
+        blit_compose_row(bench_dst_indexed, src, BENCH_TILE * BENCH_TILE - t % 3);
+        if(memcmp(check_indexed, bench_dst_indexed, sizeof(check_indexed)))
+        {
+            printf("compose mismatch on tile %i\n", t);
+            return 1;
+        }
+    }
+
+    double scalar, vector;
+
+    BENCH_RUN(scalar, blit_expand_row_scalar(bench_dst + row * BENCH_TILE, bench_tiles[tile] + row * BENCH_TILE, BENCH_TILE, bench_lut));
+    BENCH_RUN(vector, blit_expand_row(bench_dst + row * BENCH_TILE, bench_tiles[tile] + row * BENCH_TILE, BENCH_TILE, bench_lut));
+    bench_report("expand", scalar, vector);
+
+    BENCH_RUN(scalar, blit_masked_row_scalar(bench_dst + row * BENCH_TILE, bench_tiles[tile] + row * BENCH_TILE, BENCH_TILE, bench_lut));
+    BENCH_RUN(vector, blit_masked_row(bench_dst + row * BENCH_TILE, bench_tiles[tile] + row * BENCH_TILE, BENCH_TILE, bench_lut));
+    bench_report("masked", scalar, vector);
+
+    BENCH_RUN(scalar, blit_blend_row_scalar(bench_dst + row * BENCH_TILE, bench_tiles[tile] + row * BENCH_TILE, BENCH_TILE, bench_lut, BENCH_OVERLAY_ALPHA));
+    BENCH_RUN(vector, blit_blend_row(bench_dst + row * BENCH_TILE, bench_tiles[tile] + row * BENCH_TILE, BENCH_TILE, bench_lut, BENCH_OVERLAY_ALPHA));
+    bench_report("blend", scalar, vector);
+
+    BENCH_RUN(scalar, blit_compose_row_scalar(bench_dst_indexed + row * BENCH_TILE, bench_tiles[tile] + row * BENCH_TILE, BENCH_TILE));
+    BENCH_RUN(vector, blit_compose_row(bench_dst_indexed + row * BENCH_TILE, bench_tiles[tile] + row * BENCH_TILE, BENCH_TILE));
+    bench_report("compose", scalar, vector);
+
+    return 0;
+}
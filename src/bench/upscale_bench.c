@@ -0,0 +1,109 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+//Times each upscale filter on a viewport-sized indexed frame
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "upscale.h"
+
+#define BENCH_WIDTH 288
+#define BENCH_HEIGHT 288
+#define BENCH_FRAMES 200
+
+static u32 bench_lut[0x100];
+static u8 bench_frame[BENCH_WIDTH * BENCH_HEIGHT];
+static u8 bench_filtered[BENCH_WIDTH * BENCH_HEIGHT * 16];
+static u32 bench_out[BENCH_WIDTH * BENCH_HEIGHT * 16];
+static u32 bench_check[BENCH_WIDTH * 4];
+
+static double bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+int main(int argc, char **argv)
+{
+    srand(0x5941);
+    for(int i = 0; i < 0x100; i++)
+        bench_lut[i] = 0xFF000000 | (rand() & 0xFFFFFF);
+
+    //Flat 4x4 blocks with the odd stray pixel, closer to tile art than noise
+    for(int y = 0; y < BENCH_HEIGHT; y++)
+        for(int x = 0; x < BENCH_WIDTH; x++)
+            bench_frame[(y * BENCH_WIDTH) + x] = (rand() % 16) ? (((x / 4) * 7 + (y / 4) * 13) & 0xFF) : (rand() & 0xFF);
+
+    for(int scale = 2; scale <= 4; scale++)
+    {
+        int out_width = BENCH_WIDTH * scale;
+
+        //The nearest fast path against the per-pixel loop it replaces
+        upscale_nearest_row(bench_out, bench_frame, BENCH_WIDTH, scale, bench_lut);
+        for(int x = 0; x < out_width; x++)
+            bench_check[x] = bench_lut[bench_frame[x / scale]];
+        if(memcmp(bench_out, bench_check, out_width * sizeof(u32)))
+        {
+            printf("nearest x%i mismatch\n", scale);
+            return 1;
+        }
+
+        double start = bench_now();
+        for(int frame = 0; frame < BENCH_FRAMES; frame++)
+            for(int y = 0; y < BENCH_HEIGHT * scale; y++)
+                for(int x = 0; x < out_width; x++)
+                    bench_out[(y * out_width) + x] = bench_lut[bench_frame[((y / scale) * BENCH_WIDTH) + (x / scale)]];
+        double per_pixel = (bench_now() - start) / BENCH_FRAMES;
+
+        start = bench_now();
+        for(int frame = 0; frame < BENCH_FRAMES; frame++)
+        {
+            for(int y = 0; y < BENCH_HEIGHT * scale; y++)
+            {
+                if(y % scale)
+                    memcpy(bench_out + (y * out_width), bench_out + ((y - 1) * out_width), out_width * sizeof(u32));
+                else
+                    upscale_nearest_row(bench_out + (y * out_width), bench_frame + ((y / scale) * BENCH_WIDTH), BENCH_WIDTH, scale, bench_lut);
+            }
+        }
+        double nearest = (bench_now() - start) / BENCH_FRAMES;
+        printf("x%i %-9s %8.3f ms  (per-pixel loop %8.3f ms)\n", scale, upscale_filter_names[UPSCALE_NEAREST], nearest * 1000, per_pixel * 1000);
+
+        for(u8 filter = UPSCALE_SCALENX; filter < UPSCALE_NUM_FILTERS; filter++)
+        {
+            if(!upscale_filter_supports(filter, scale))
+                continue;
+
+            start = bench_now();
+            for(int frame = 0; frame < BENCH_FRAMES; frame++)
+                upscale_filter_indexed(bench_filtered, bench_frame, BENCH_WIDTH, BENCH_HEIGHT, scale, filter, bench_lut);
+            double filtered = (bench_now() - start) / BENCH_FRAMES;
+            printf("x%i %-9s %8.3f ms  (filter only)\n", scale, upscale_filter_names[filter], filtered * 1000);
+        }
+    }
+
+    return 0;
+}
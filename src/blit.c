@@ -0,0 +1,453 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "blit.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(BLIT_AVX2)
+#include <immintrin.h>
+const char *blit_kernel_name = "avx2";
+#elif defined(BLIT_SSE2)
+#include <emmintrin.h>
+const char *blit_kernel_name = "sse2";
+#elif defined(BLIT_NEON)
+#include <arm_neon.h>
+const char *blit_kernel_name = "neon";
+#else
+const char *blit_kernel_name = "swar";
+#endif
+
+//Same rounding as framebuffer_blend, alpha forced opaque
+static inline u32 blit_blend(u32 dst, u32 src, u8 alpha)
+{
+    u32 rb = ((((src & 0xFF00FF) * alpha) + ((dst & 0xFF00FF) * (255 - alpha))) >> 8) & 0xFF00FF;
+    u32 g = ((((src & 0x00FF00) * alpha) + ((dst & 0x00FF00) * (255 - alpha))) >> 8) & 0x00FF00;
+    return 0xFF000000 | rb | g;
+}
+
+blit_spans *blit_spans_build(const u8 *src)
+{
+    u8 data[32 * (1 + 32)];
+    u16 row[32];
+    u32 size = 0;
+    u32 opaque = 0;
+
+    for(int y = 0; y < 32; y++)
+    {
+        const u8 *in = src + (y * 32);
+        u32 count_at = size++;
+        u8 count = 0;
+
+        row[y] = count_at;
+        for(int x = 0; x < 32;)
+        {
+            if(!in[x])
+            {
+                x++;
+                continue;
+            }
+
+            int start = x;
+            while(x < 32 && in[x])
+                x++;
+
+            data[size++] = start;
+            data[size++] = x - start;
+            opaque += x - start;
+            count++;
+        }
+        data[count_at] = count;
+    }
+
+    blit_spans *spans = malloc(sizeof(blit_spans) + size);
+    spans->flags = 0;
+    spans->pad = 0;
+    if(!opaque)
+        spans->flags |= BLIT_SPANS_EMPTY;
+    else if(opaque == 32 * 32)
+        spans->flags |= BLIT_SPANS_OPAQUE;
+
+    memcpy(spans->row, row, sizeof(row));
+    memcpy(spans->data, data, size);
+    return spans;
+}
+
+//Copies just the opaque runs of a tile into an indexed surface
+void blit_spans_compose(u8 *dst, int dst_pitch, const blit_spans *spans, const u8 *src)
+{
+    if(spans->flags & BLIT_SPANS_EMPTY)
+        return;
+
+    for(int y = 0; y < 32; y++)
+    {
+        u8 *out = dst + (y * dst_pitch);
+        const u8 *in = src + (y * 32);
+
+        if(spans->flags & BLIT_SPANS_OPAQUE)
+        {
+            memcpy(out, in, 32);
+            continue;
+        }
+
+        const u8 *span = spans->data + spans->row[y];
+        for(int i = 0; i < span[0]; i++)
+            memcpy(out + span[1 + (i * 2)], in + span[1 + (i * 2)], span[2 + (i * 2)]);
+    }
+}
+
+void blit_expand_row_scalar(u32 *dst, const u8 *src, int count, const u32 *lut)
+{
+    for(int i = 0; i < count; i++)
+        dst[i] = lut[src[i]];
+}
+
+void blit_masked_row_scalar(u32 *dst, const u8 *src, int count, const u32 *lut)
+{
+    for(int i = 0; i < count; i++)
+    {
+        if(src[i])
+            dst[i] = lut[src[i]];
+    }
+}
+
+void blit_blend_row_scalar(u32 *dst, const u8 *src, int count, const u32 *lut, u8 alpha)
+{
+    for(int i = 0; i < count; i++)
+    {
+        if(src[i])
+            dst[i] = blit_blend(dst[i], lut[src[i]], alpha);
+    }
+}
+
+void blit_compose_row_scalar(u8 *dst, const u8 *src, int count)
+{
+    for(int i = 0; i < count; i++)
+    {
+        if(src[i])
+            dst[i] = src[i];
+    }
+}
+
+#if defined(BLIT_AVX2)
+
+void blit_expand_row(u32 *dst, const u8 *src, int count, const u32 *lut)
+{
+    int i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_i32gather_epi32((const int*)lut, index, 4));
+    }
+    blit_expand_row_scalar(dst + i, src + i, count - i, lut);
+}
+
+void blit_masked_row(u32 *dst, const u8 *src, int count, const u32 *lut)
+{
+    int i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+        __m256i mask = _mm256_cmpeq_epi32(index, _mm256_setzero_si256());
+        __m256i color = _mm256_i32gather_epi32((const int*)lut, index, 4);
+        __m256i out = _mm256_loadu_si256((const __m256i*)(dst + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_blendv_epi8(color, out, mask));
+    }
+    blit_masked_row_scalar(dst + i, src + i, count - i, lut);
+}
+
+void blit_blend_row(u32 *dst, const u8 *src, int count, const u32 *lut, u8 alpha)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i a = _mm256_set1_epi16(alpha);
+    const __m256i inv_a = _mm256_set1_epi16(255 - alpha);
+    const __m256i opaque = _mm256_set1_epi32(0xFF000000);
+
+    int i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+        __m256i mask = _mm256_cmpeq_epi32(index, zero);
+        __m256i color = _mm256_i32gather_epi32((const int*)lut, index, 4);
+        __m256i out = _mm256_loadu_si256((const __m256i*)(dst + i));
+
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(color, zero), a), _mm256_mullo_epi16(_mm256_unpacklo_epi8(out, zero), inv_a));
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(color, zero), a), _mm256_mullo_epi16(_mm256_unpackhi_epi8(out, zero), inv_a));
+        __m256i blended = _mm256_or_si256(_mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8)), opaque);
+
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_blendv_epi8(blended, out, mask));
+    }
+    blit_blend_row_scalar(dst + i, src + i, count - i, lut, alpha);
+}
+
+void blit_compose_row(u8 *dst, const u8 *src, int count)
+{
+    int i = 0;
+    for(; i + 32 <= count; i += 32)
+    {
+        __m256i in = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i out = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i mask = _mm256_cmpeq_epi8(in, _mm256_setzero_si256());
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_blendv_epi8(in, out, mask));
+    }
+    blit_compose_row_scalar(dst + i, src + i, count - i);
+}
+
+#elif defined(BLIT_SSE2)
+
+//SSE2 has no gather, so colors are fetched four at a time and masked in-register
+static inline __m128i blit_gather4(const u8 *src, const u32 *lut)
+{
+    return _mm_set_epi32(lut[src[3]], lut[src[2]], lut[src[1]], lut[src[0]]);
+}
+
+static inline __m128i blit_zero_mask4(const u8 *src)
+{
+    u32 packed;
+    memcpy(&packed, src, sizeof(packed));
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i index = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+    return _mm_cmpeq_epi32(index, zero);
+}
+
+static inline __m128i blit_select(__m128i mask, __m128i if_set, __m128i if_clear)
+{
+    return _mm_or_si128(_mm_and_si128(mask, if_set), _mm_andnot_si128(mask, if_clear));
+}
+
+void blit_expand_row(u32 *dst, const u8 *src, int count, const u32 *lut)
+{
+    int i = 0;
+    for(; i + 4 <= count; i += 4)
+        _mm_storeu_si128((__m128i*)(dst + i), blit_gather4(src + i, lut));
+    blit_expand_row_scalar(dst + i, src + i, count - i, lut);
+}
+
+void blit_masked_row(u32 *dst, const u8 *src, int count, const u32 *lut)
+{
+    int i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128i out = _mm_loadu_si128((const __m128i*)(dst + i));
+        _mm_storeu_si128((__m128i*)(dst + i), blit_select(blit_zero_mask4(src + i), out, blit_gather4(src + i, lut)));
+    }
+    blit_masked_row_scalar(dst + i, src + i, count - i, lut);
+}
+
+void blit_blend_row(u32 *dst, const u8 *src, int count, const u32 *lut, u8 alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i a = _mm_set1_epi16(alpha);
+    const __m128i inv_a = _mm_set1_epi16(255 - alpha);
+    const __m128i opaque = _mm_set1_epi32(0xFF000000);
+
+    int i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128i color = blit_gather4(src + i, lut);
+        __m128i out = _mm_loadu_si128((const __m128i*)(dst + i));
+
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(color, zero), a), _mm_mullo_epi16(_mm_unpacklo_epi8(out, zero), inv_a));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(color, zero), a), _mm_mullo_epi16(_mm_unpackhi_epi8(out, zero), inv_a));
+        __m128i blended = _mm_or_si128(_mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)), opaque);
+
+        _mm_storeu_si128((__m128i*)(dst + i), blit_select(blit_zero_mask4(src + i), out, blended));
+    }
+    blit_blend_row_scalar(dst + i, src + i, count - i, lut, alpha);
+}
+
+void blit_compose_row(u8 *dst, const u8 *src, int count)
+{
+    int i = 0;
+    for(; i + 16 <= count; i += 16)
+    {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i out = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i mask = _mm_cmpeq_epi8(in, _mm_setzero_si128());
+        _mm_storeu_si128((__m128i*)(dst + i), blit_select(mask, out, in));
+    }
+    blit_compose_row_scalar(dst + i, src + i, count - i);
+}
+
+#elif defined(BLIT_NEON)
+
+//NEON has no gather either, colors are looked up eight at a time and selected with vbsl
+static inline void blit_gather8(const u8 *src, const u32 *lut, uint32x4_t *lo, uint32x4_t *hi)
+{
+    u32 colors[8];
+    for(int i = 0; i < 8; i++)
+        colors[i] = lut[src[i]];
+
+    *lo = vld1q_u32(colors);
+    *hi = vld1q_u32(colors + 4);
+}
+
+static inline void blit_zero_mask8(const u8 *src, uint32x4_t *lo, uint32x4_t *hi)
+{
+    int16x8_t mask = vreinterpretq_s16_u16(vceqq_u16(vmovl_u8(vld1_u8(src)), vdupq_n_u16(0)));
+    *lo = vreinterpretq_u32_s32(vmovl_s16(vget_low_s16(mask)));
+    *hi = vreinterpretq_u32_s32(vmovl_s16(vget_high_s16(mask)));
+}
+
+static inline uint32x4_t blit_blend4(uint32x4_t dst, uint32x4_t src, uint8x8_t a, uint8x8_t inv_a)
+{
+    uint8x16_t s = vreinterpretq_u8_u32(src);
+    uint8x16_t d = vreinterpretq_u8_u32(dst);
+
+    uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(s), a), vget_low_u8(d), inv_a);
+    uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(s), a), vget_high_u8(d), inv_a);
+    uint8x16_t out = vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+
+    return vorrq_u32(vreinterpretq_u32_u8(out), vdupq_n_u32(0xFF000000));
+}
+
+void blit_expand_row(u32 *dst, const u8 *src, int count, const u32 *lut)
+{
+    int i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        uint32x4_t lo, hi;
+        blit_gather8(src + i, lut, &lo, &hi);
+        vst1q_u32(dst + i, lo);
+        vst1q_u32(dst + i + 4, hi);
+    }
+    blit_expand_row_scalar(dst + i, src + i, count - i, lut);
+}
+
+void blit_masked_row(u32 *dst, const u8 *src, int count, const u32 *lut)
+{
+    int i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        uint32x4_t lo, hi, mask_lo, mask_hi;
+        blit_gather8(src + i, lut, &lo, &hi);
+        blit_zero_mask8(src + i, &mask_lo, &mask_hi);
+        vst1q_u32(dst + i, vbslq_u32(mask_lo, vld1q_u32(dst + i), lo));
+        vst1q_u32(dst + i + 4, vbslq_u32(mask_hi, vld1q_u32(dst + i + 4), hi));
+    }
+    blit_masked_row_scalar(dst + i, src + i, count - i, lut);
+}
+
+void blit_blend_row(u32 *dst, const u8 *src, int count, const u32 *lut, u8 alpha)
+{
+    uint8x8_t a = vdup_n_u8(alpha);
+    uint8x8_t inv_a = vdup_n_u8(255 - alpha);
+
+    int i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        uint32x4_t lo, hi, mask_lo, mask_hi;
+        blit_gather8(src + i, lut, &lo, &hi);
+        blit_zero_mask8(src + i, &mask_lo, &mask_hi);
+
+        uint32x4_t out_lo = vld1q_u32(dst + i);
+        uint32x4_t out_hi = vld1q_u32(dst + i + 4);
+        vst1q_u32(dst + i, vbslq_u32(mask_lo, out_lo, blit_blend4(out_lo, lo, a, inv_a)));
+        vst1q_u32(dst + i + 4, vbslq_u32(mask_hi, out_hi, blit_blend4(out_hi, hi, a, inv_a)));
+    }
+    blit_blend_row_scalar(dst + i, src + i, count - i, lut, alpha);
+}
+
+void blit_compose_row(u8 *dst, const u8 *src, int count)
+{
+    int i = 0;
+    for(; i + 16 <= count; i += 16)
+    {
+        uint8x16_t in = vld1q_u8(src + i);
+        uint8x16_t mask = vceqq_u8(in, vdupq_n_u8(0));
+        vst1q_u8(dst + i, vbslq_u8(mask, vld1q_u8(dst + i), in));
+    }
+    blit_compose_row_scalar(dst + i, src + i, count - i);
+}
+
+#else
+
+//No usable vector unit (3DS, and Wii U whose paired singles are float-only),
+//so the byte-parallel work is done four indices at a time in a word
+
+//0xFF in every byte of x that is zero
+static inline u32 blit_zero_bytes(u32 x)
+{
+    u32 t = ~(((x & 0x7F7F7F7F) + 0x7F7F7F7F) | x | 0x7F7F7F7F);
+    return (t >> 7) * 0xFF;
+}
+
+void blit_expand_row(u32 *dst, const u8 *src, int count, const u32 *lut)
+{
+    int i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        dst[i] = lut[src[i]];
+        dst[i + 1] = lut[src[i + 1]];
+        dst[i + 2] = lut[src[i + 2]];
+        dst[i + 3] = lut[src[i + 3]];
+    }
+    blit_expand_row_scalar(dst + i, src + i, count - i, lut);
+}
+
+void blit_masked_row(u32 *dst, const u8 *src, int count, const u32 *lut)
+{
+    int i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        u32 packed;
+        memcpy(&packed, src + i, sizeof(packed));
+        if(!packed)
+            continue;
+
+        blit_masked_row_scalar(dst + i, src + i, 4, lut);
+    }
+    blit_masked_row_scalar(dst + i, src + i, count - i, lut);
+}
+
+void blit_blend_row(u32 *dst, const u8 *src, int count, const u32 *lut, u8 alpha)
+{
+    int i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        u32 packed;
+        memcpy(&packed, src + i, sizeof(packed));
+        if(!packed)
+            continue;
+
+        blit_blend_row_scalar(dst + i, src + i, 4, lut, alpha);
+    }
+    blit_blend_row_scalar(dst + i, src + i, count - i, lut, alpha);
+}
+
+void blit_compose_row(u8 *dst, const u8 *src, int count)
+{
+    int i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        u32 in, out;
+        memcpy(&in, src + i, sizeof(in));
+        memcpy(&out, dst + i, sizeof(out));
+
+        u32 mask = blit_zero_bytes(in);
+        out = (out & mask) | (in & ~mask);
+        memcpy(dst + i, &out, sizeof(out));
+    }
+    blit_compose_row_scalar(dst + i, src + i, count - i);
+}
+
+#endif
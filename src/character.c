@@ -38,3 +38,4 @@ const u8 CHAR_ATTACK_EXTEND_DOWN_ANIM[4] = {FRAME_ATTACK_EXTEND_DOWN_1, FRAME_AT
 const u8 CHAR_ATTACK_EXTEND_LEFT_ANIM[4] = {FRAME_ATTACK_EXTEND_LEFT_1, FRAME_ATTACK_EXTEND_LEFT_2, FRAME_ATTACK_EXTEND_LEFT_1, FRAME_ATTACK_EXTEND_LEFT_2};
 const u8 CHAR_ATTACK_EXTEND_RIGHT_ANIM[4] = {FRAME_ATTACK_EXTEND_RIGHT_1, FRAME_ATTACK_EXTEND_RIGHT_2, FRAME_ATTACK_EXTEND_RIGHT_1, FRAME_ATTACK_EXTEND_RIGHT_2};
 ichr_data **char_data;
+u16 char_count;
@@ -0,0 +1,271 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "frame.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "assets.h"
+#include "map.h"
+#include "palette.h"
+#include "player.h"
+
+#ifdef PC_BUILD
+#include <SDL2/SDL.h>
+#endif
+
+bool frame_threaded = false;
+const screen_frame *frame_current = NULL;
+
+//Slots trade places on publish and acquire, publishers only write back and the renderer only reads front
+screen_frame frame_slots[3];
+int frame_back = 0;
+int frame_ready = 1;
+int frame_front = 2;
+bool frame_ready_fresh = false;
+u32 frame_sequence = 0;
+
+//What the last capture saw, to tell whether the next one changed anything
+bool frame_pending_changed = true;
+char *frame_last_text = NULL;
+int frame_last_text_x, frame_last_text_y;
+u8 frame_last_fade = 0;
+bool frame_last_has_inventory = false;
+u16 frame_last_inventory[0x100];
+u16 frame_last_equipped = 0xFFFF;
+
+#ifdef PC_BUILD
+SDL_mutex *frame_slot_lock = NULL;
+SDL_mutex *frame_world_lock = NULL;
+SDL_threadID frame_render_thread;
+#endif
+
+void frame_init()
+{
+#ifdef PC_BUILD
+    if(!frame_slot_lock)
+        frame_slot_lock = SDL_CreateMutex();
+    if(!frame_world_lock)
+        frame_world_lock = SDL_CreateMutex();
+    frame_render_thread = SDL_ThreadID();
+#endif
+}
+
+//Forces the next frame to count as changed, for state the capture doesn't compare
+void frame_mark_changed()
+{
+    frame_pending_changed = true;
+}
+
+static bool frame_capture_inventory(screen_frame *frame)
+{
+    frame->has_inventory = player_inventory != NULL;
+    frame->equipped_item = PLAYER_EQUIPPED_ITEM;
+    if(player_inventory)
+        memcpy(frame->inventory, player_inventory, sizeof(frame->inventory));
+
+    bool changed = frame->has_inventory != frame_last_has_inventory || frame->equipped_item != frame_last_equipped
+                   || (frame->has_inventory && memcmp(frame->inventory, frame_last_inventory, sizeof(frame->inventory)));
+
+    frame_last_has_inventory = frame->has_inventory;
+    frame_last_equipped = frame->equipped_item;
+    memcpy(frame_last_inventory, frame->inventory, sizeof(frame->inventory));
+    return changed;
+}
+
+static void frame_capture_text(screen_frame *frame)
+{
+    frame->has_text = false;
+    frame->text_x = active_text_x;
+    frame->text_y = active_text_y;
+    if(!active_text)
+        return;
+
+    u32 size = strlen(active_text) + 1;
+    if(frame->text_size < size)
+    {
+        char *text = realloc(frame->text, size);
+        if(!text)
+            return;
+
+        frame->text = text;
+        frame->text_size = size;
+    }
+
+    memcpy(frame->text, active_text, size);
+    frame->has_text = true;
+}
+
+static void frame_capture(screen_frame *frame)
+{
+    u32 cells = SCREEN_TILE_WIDTH * SCREEN_TILE_HEIGHT;
+    if(frame->cells != cells)
+    {
+        free(frame->tiles_low);
+        frame->tiles_low = malloc(cells * sizeof(u16) * 5);
+        frame->tiles_middle = frame->tiles_low + cells;
+        frame->tiles_middle_overlay = frame->tiles_middle + cells;
+        frame->tiles_high = frame->tiles_middle_overlay + cells;
+        frame->tiles_overlay = frame->tiles_high + cells;
+        frame->cells = cells;
+    }
+
+    //The five screen layers are one allocation in the same order, and don't exist until the screen is set up
+    if(tiles_low)
+        memcpy(frame->tiles_low, tiles_low, cells * sizeof(u16) * 5);
+    else
+        memset(frame->tiles_low, 0xFF, cells * sizeof(u16) * 5);
+
+    frame->dirty_all = screen_dirty_all;
+    frame->dirty_count = screen_dirty_all ? 0 : screen_dirty_count;
+    memcpy(frame->dirty_cells, screen_dirty_cells, frame->dirty_count * sizeof(u16));
+
+    frame->map_id = map_get_id();
+    frame->map_width = map_get_width();
+    frame->map_height = map_get_height();
+    frame->camera_x = map_camera_x;
+    frame->camera_y = map_camera_y;
+    frame->fade = SCREEN_FADE_LEVEL;
+
+    frame->loading = ASSETS_LOADING;
+    frame->loading_percent = ASSETS_PERCENT;
+
+    memcpy(frame->palette, is_yoda ? yodesk_palette : indy_palette, 0x400);
+    frame_capture_text(frame);
+
+    bool inventory_changed = frame_capture_inventory(frame);
+    frame->changed = frame_pending_changed || inventory_changed || frame->dirty_all || frame->dirty_count || frame->loading
+                     || active_text != frame_last_text || active_text_x != frame_last_text_x || active_text_y != frame_last_text_y
+                     || frame->fade != frame_last_fade;
+
+    frame_pending_changed = false;
+    frame_last_text = active_text;
+    frame_last_text_x = active_text_x;
+    frame_last_text_y = active_text_y;
+    frame_last_fade = frame->fade;
+    frame->sequence = ++frame_sequence;
+}
+
+//A frame replacing one the renderer never took has to carry that frame's changes forward
+static void frame_merge(screen_frame *frame, const screen_frame *skipped)
+{
+    frame->changed |= skipped->changed;
+    if(frame->dirty_all)
+        return;
+
+    if(skipped->dirty_all || frame->dirty_count + skipped->dirty_count > SCREEN_MAX_DIRTY)
+    {
+        frame->dirty_all = true;
+        frame->dirty_count = 0;
+        return;
+    }
+
+    memcpy(frame->dirty_cells + frame->dirty_count, skipped->dirty_cells, skipped->dirty_count * sizeof(u16));
+    frame->dirty_count += skipped->dirty_count;
+}
+
+static void frame_slots_lock()
+{
+#ifdef PC_BUILD
+    SDL_LockMutex(frame_slot_lock);
+#endif
+}
+
+static void frame_slots_unlock()
+{
+#ifdef PC_BUILD
+    SDL_UnlockMutex(frame_slot_lock);
+#endif
+}
+
+//Captures the current game state as the newest frame, callers hold the world lock
+void frame_publish()
+{
+    screen_frame *frame = &frame_slots[frame_back];
+    frame_capture(frame);
+
+    frame_slots_lock();
+    if(frame_ready_fresh)
+        frame_merge(frame, &frame_slots[frame_ready]);
+
+    frame_back = frame_ready;
+    frame_ready = frame - frame_slots;
+    frame_ready_fresh = true;
+    frame_slots_unlock();
+}
+
+//The newest published frame, fresh is set if it wasn't handed out before
+const screen_frame *frame_acquire(bool *fresh)
+{
+    frame_slots_lock();
+    *fresh = frame_ready_fresh;
+    if(frame_ready_fresh)
+    {
+        int front = frame_front;
+        frame_front = frame_ready;
+        frame_ready = front;
+        frame_ready_fresh = false;
+    }
+    frame_slots_unlock();
+
+    return &frame_slots[frame_front];
+}
+
+//Called from the render thread before the simulation thread starts
+void frame_start_threaded()
+{
+    frame_init();
+    frame_threaded = true;
+}
+
+bool frame_on_render_thread()
+{
+#ifdef PC_BUILD
+    return SDL_ThreadID() == frame_render_thread;
+#else
+    return true;
+#endif
+}
+
+//Held by whichever thread is changing game state
+void frame_lock_world()
+{
+#ifdef PC_BUILD
+    if(frame_threaded)
+        SDL_LockMutex(frame_world_lock);
+#endif
+}
+
+bool frame_try_lock_world()
+{
+#ifdef PC_BUILD
+    if(frame_threaded)
+        return SDL_TryLockMutex(frame_world_lock) == 0;
+#endif
+    return true;
+}
+
+void frame_unlock_world()
+{
+#ifdef PC_BUILD
+    if(frame_threaded)
+        SDL_UnlockMutex(frame_world_lock);
+#endif
+}
@@ -0,0 +1,387 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "framebuffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "jobs.h"
+#include "upscale.h"
+
+/*
+ * Everything the game and UI draw ends up here, and the platform
+ * uploads it once per frame in render_flip_buffers. A platform can
+ * also bind memory it owns (a locked texture) for the span of a frame.
+ */
+
+u32 *framebuffer = NULL;
+u32 *framebuffer_owned = NULL;
+int framebuffer_width = 0;
+int framebuffer_height = 0;
+int framebuffer_pitch = 0; //In pixels
+u32 framebuffer_palette[0x100];
+
+u8 *framebuffer_indexed = NULL;
+int framebuffer_indexed_width = 0;
+int framebuffer_indexed_height = 0;
+u32 framebuffer_indexed_version = 0;
+
+/*
+ * The viewport run through upscale_filter, rebuilt when the viewport changes.
+ * Edge decisions made against an older palette are kept through palette cycling.
+ */
+u8 *framebuffer_filtered = NULL;
+u32 framebuffer_filtered_size = 0;
+bool framebuffer_filtered_valid = false;
+u32 framebuffer_filtered_version = 0;
+u8 framebuffer_filtered_filter = UPSCALE_NEAREST;
+int framebuffer_filtered_scale = 1;
+
+void framebuffer_init(int width, int height)
+{
+    free(framebuffer_owned);
+
+    framebuffer_owned = calloc(width * height, sizeof(u32));
+    framebuffer = framebuffer_owned;
+    framebuffer_width = width;
+    framebuffer_height = height;
+    framebuffer_pitch = width;
+}
+
+//Draws into external pixels of the same size until unbound with NULL, nothing is preserved across binds
+void framebuffer_bind(u32 *pixels, int pitch)
+{
+    if(pixels)
+    {
+        framebuffer = pixels;
+        framebuffer_pitch = pitch;
+    }
+    else
+    {
+        framebuffer = framebuffer_owned;
+        framebuffer_pitch = framebuffer_width;
+    }
+}
+
+//Palette animation only touches the BGRA palette, so this is redone each frame from the frame's copy
+void framebuffer_update_palette(const u8 *palette)
+{
+    for(int i = 0; i < 0x100; i++)
+        framebuffer_palette[i] = FRAMEBUFFER_ARGB(0xFF, palette[(i * 4) + 2], palette[(i * 4) + 1], palette[i * 4]);
+
+    //Nothing drawn over the viewport background comes out black
+    framebuffer_palette[0] = FRAMEBUFFER_ARGB(0xFF, 0, 0, 0);
+}
+
+static inline u32 framebuffer_blend(u32 dst, u32 src, u8 alpha)
+{
+    u32 rb = ((((src & 0xFF00FF) * alpha) + ((dst & 0xFF00FF) * (255 - alpha))) >> 8) & 0xFF00FF;
+    u32 g = ((((src & 0x00FF00) * alpha) + ((dst & 0x00FF00) * (255 - alpha))) >> 8) & 0x00FF00;
+    return 0xFF000000 | rb | g;
+}
+
+//Intersects a rectangle with the clip and the framebuffer, false if nothing is left
+static bool framebuffer_clip(int *x1, int *y1, int *x2, int *y2, const framebuffer_rect *clip)
+{
+    *x1 = MAX(*x1, 0);
+    *y1 = MAX(*y1, 0);
+    *x2 = MIN(*x2, framebuffer_width);
+    *y2 = MIN(*y2, framebuffer_height);
+
+    if(clip)
+    {
+        *x1 = MAX(*x1, clip->x1);
+        *y1 = MAX(*y1, clip->y1);
+        *x2 = MIN(*x2, clip->x2);
+        *y2 = MIN(*y2, clip->y2);
+    }
+
+    return *x1 < *x2 && *y1 < *y2;
+}
+
+void framebuffer_fill(u32 color)
+{
+    for(int i = 0; i < framebuffer_width; i++)
+        framebuffer[i] = color;
+
+    for(int y = 1; y < framebuffer_height; y++)
+        memcpy(framebuffer + (y * framebuffer_pitch), framebuffer, framebuffer_width * sizeof(u32));
+}
+
+void framebuffer_fill_rect(int x1, int y1, int x2, int y2, u32 color, const framebuffer_rect *clip)
+{
+    if(!framebuffer_clip(&x1, &y1, &x2, &y2, clip))
+        return;
+
+    u8 alpha = color >> 24;
+    for(int y = y1; y < y2; y++)
+    {
+        u32 *row = framebuffer + (y * framebuffer_pitch);
+        if(alpha == 0xFF)
+        {
+            for(int x = x1; x < x2; x++)
+                row[x] = color;
+        }
+        else
+        {
+            for(int x = x1; x < x2; x++)
+                row[x] = framebuffer_blend(row[x], color, alpha);
+        }
+    }
+}
+
+//Draws 8bpp indices through the palette, index 0 is transparent
+void framebuffer_blit_indexed(int x, int y, int width, int height, int scale, const u8 *src, u8 alpha, const framebuffer_rect *clip)
+{
+    int x1 = x, y1 = y;
+    int x2 = x + (width * scale), y2 = y + (height * scale);
+    if(!framebuffer_clip(&x1, &y1, &x2, &y2, clip))
+        return;
+
+    for(int dy = y1; dy < y2; dy++)
+    {
+        const u8 *src_row = src + (((dy - y) / scale) * width);
+        u32 *row = framebuffer + (dy * framebuffer_pitch);
+
+        if(scale == 1)
+        {
+            if(alpha == 0xFF)
+                blit_masked_row(row + x1, src_row + (x1 - x), x2 - x1, framebuffer_palette);
+            else
+                blit_blend_row(row + x1, src_row + (x1 - x), x2 - x1, framebuffer_palette, alpha);
+        }
+        else
+        {
+            for(int dx = x1; dx < x2; dx++)
+            {
+                u8 index = src_row[(dx - x) / scale];
+                if(!index)
+                    continue;
+
+                row[dx] = alpha == 0xFF ? framebuffer_palette[index] : framebuffer_blend(row[dx], framebuffer_palette[index], alpha);
+            }
+        }
+    }
+}
+
+//Draws a 32x32 tile through its span list, only touching opaque runs
+void framebuffer_blit_spans(int x, int y, int scale, const blit_spans *spans, const u8 *src, u8 alpha, const framebuffer_rect *clip)
+{
+    if(spans->flags & BLIT_SPANS_EMPTY)
+        return;
+
+    int x1 = x, y1 = y;
+    int x2 = x + (32 * scale), y2 = y + (32 * scale);
+    if(!framebuffer_clip(&x1, &y1, &x2, &y2, clip))
+        return;
+
+    for(int dy = y1; dy < y2; dy++)
+    {
+        int sy = (dy - y) / scale;
+        const u8 *src_row = src + (sy * 32);
+        u32 *row = framebuffer + (dy * framebuffer_pitch);
+
+        if(spans->flags & BLIT_SPANS_OPAQUE && alpha == 0xFF && scale == 1)
+        {
+            blit_expand_row(row + x1, src_row + (x1 - x), x2 - x1, framebuffer_palette);
+            continue;
+        }
+
+        const u8 *span = spans->data + spans->row[sy];
+        for(int i = 0; i < span[0]; i++)
+        {
+            int start = x + (span[1 + (i * 2)] * scale);
+            int end = start + (span[2 + (i * 2)] * scale);
+            start = MAX(start, x1);
+            end = MIN(end, x2);
+            if(start >= end)
+                continue;
+
+            if(scale == 1)
+            {
+                if(alpha == 0xFF)
+                    blit_expand_row(row + start, src_row + (start - x), end - start, framebuffer_palette);
+                else
+                    blit_blend_row(row + start, src_row + (start - x), end - start, framebuffer_palette, alpha);
+                continue;
+            }
+
+            for(int dx = start; dx < end; dx++)
+            {
+                u32 color = framebuffer_palette[src_row[(dx - x) / scale]];
+                row[dx] = alpha == 0xFF ? color : framebuffer_blend(row[dx], color, alpha);
+            }
+        }
+    }
+}
+
+//Fills every pixel of a width x height mask that's nonzero, used for pre-laid-out text
+void framebuffer_blit_mask(int x, int y, int width, int height, int scale, const u8 *mask, u32 color, const framebuffer_rect *clip)
+{
+    int x1 = x, y1 = y;
+    int x2 = x + (width * scale), y2 = y + (height * scale);
+    if(!framebuffer_clip(&x1, &y1, &x2, &y2, clip))
+        return;
+
+    for(int dy = y1; dy < y2; dy++)
+    {
+        const u8 *mask_row = mask + (((dy - y) / scale) * width);
+        u32 *row = framebuffer + (dy * framebuffer_pitch);
+
+        for(int dx = x1; dx < x2; dx++)
+        {
+            if(mask_row[(dx - x) / scale])
+                row[dx] = color;
+        }
+    }
+}
+
+//True when the viewport was (re)allocated and its contents are gone
+bool framebuffer_init_indexed(int width, int height)
+{
+    if(framebuffer_indexed && width == framebuffer_indexed_width && height == framebuffer_indexed_height)
+        return false;
+
+    free(framebuffer_indexed);
+    framebuffer_indexed = calloc(width * height, sizeof(u8));
+    framebuffer_indexed_width = width;
+    framebuffer_indexed_height = height;
+    framebuffer_indexed_version++;
+    return true;
+}
+
+void framebuffer_clear_indexed(u8 index)
+{
+    memset(framebuffer_indexed, index, framebuffer_indexed_width * framebuffer_indexed_height);
+    framebuffer_indexed_version++;
+}
+
+//Copies indices over the viewport, skipping the transparent index 0
+void framebuffer_compose_indexed(int x, int y, int width, int height, const u8 *src)
+{
+    int x1 = MAX(x, 0), y1 = MAX(y, 0);
+    int x2 = MIN(x + width, framebuffer_indexed_width), y2 = MIN(y + height, framebuffer_indexed_height);
+    if(x1 >= x2 || y1 >= y2)
+        return;
+
+    framebuffer_indexed_version++;
+    for(int dy = y1; dy < y2; dy++)
+    {
+        const u8 *in = src + ((dy - y) * width) + (x1 - x);
+        u8 *row = framebuffer_indexed + (dy * framebuffer_indexed_width);
+        blit_compose_row(row + x1, in, x2 - x1);
+    }
+}
+
+//Like framebuffer_compose_indexed, but index 0 overwrites too
+void framebuffer_copy_indexed(int x, int y, int width, int height, const u8 *src)
+{
+    int x1 = MAX(x, 0), y1 = MAX(y, 0);
+    int x2 = MIN(x + width, framebuffer_indexed_width), y2 = MIN(y + height, framebuffer_indexed_height);
+    if(x1 >= x2 || y1 >= y2)
+        return;
+
+    framebuffer_indexed_version++;
+    for(int dy = y1; dy < y2; dy++)
+        memcpy(framebuffer_indexed + (dy * framebuffer_indexed_width) + x1, src + ((dy - y) * width) + (x1 - x), x2 - x1);
+}
+
+//What every band of one resolve shares, x1/x2 are the clipped output columns
+typedef struct framebuffer_resolve_args
+{
+    const u8 *src;
+    int src_width;
+    int x;
+    int y;
+    int x1;
+    int x2;
+    int scale;
+} framebuffer_resolve_args;
+
+static void framebuffer_resolve_band(void *arg, int y1, int y2)
+{
+    const framebuffer_resolve_args *args = arg;
+    int x = args->x, y = args->y, x1 = args->x1, x2 = args->x2, scale = args->scale;
+
+    for(int dy = y1; dy < y2; dy++)
+    {
+        int sy = (dy - y) / scale;
+        const u8 *in = args->src + (sy * args->src_width);
+        u32 *row = framebuffer + (dy * framebuffer_pitch);
+
+        if(scale == 1)
+            blit_expand_row(row + x1, in + (x1 - x), x2 - x1, framebuffer_palette);
+        else if(dy > y1 && (dy - 1 - y) / scale == sy)
+            memcpy(row + x1, row - framebuffer_pitch + x1, (x2 - x1) * sizeof(u32));
+        else if(x1 == x && x2 == x + (args->src_width * scale))
+            upscale_nearest_row(row + x, in, args->src_width, scale, framebuffer_palette);
+        else
+        {
+            for(int dx = x1; dx < x2; dx++)
+                row[dx] = framebuffer_palette[in[(dx - x) / scale]];
+        }
+    }
+}
+
+//Runs the upscale filter over the viewport if it changed since the last frame
+static const u8 *framebuffer_filter_indexed(int scale)
+{
+    u32 size = framebuffer_indexed_width * framebuffer_indexed_height * scale * scale;
+    if(size > framebuffer_filtered_size)
+    {
+        free(framebuffer_filtered);
+        framebuffer_filtered = malloc(size);
+        framebuffer_filtered_size = size;
+        framebuffer_filtered_valid = false;
+    }
+
+    if(!framebuffer_filtered_valid || framebuffer_filtered_version != framebuffer_indexed_version
+       || framebuffer_filtered_filter != upscale_filter || framebuffer_filtered_scale != scale)
+    {
+        upscale_filter_indexed(framebuffer_filtered, framebuffer_indexed, framebuffer_indexed_width, framebuffer_indexed_height, scale, upscale_filter, framebuffer_palette);
+        framebuffer_filtered_valid = true;
+        framebuffer_filtered_version = framebuffer_indexed_version;
+        framebuffer_filtered_filter = upscale_filter;
+        framebuffer_filtered_scale = scale;
+    }
+
+    return framebuffer_filtered;
+}
+
+//Expands the viewport to ARGB at (x,y). Scaled output rows are independent,
+//so they're split into bands across the job workers
+void framebuffer_resolve_indexed(int x, int y, int scale, const framebuffer_rect *clip)
+{
+    int x1 = x, y1 = y;
+    int x2 = x + (framebuffer_indexed_width * scale), y2 = y + (framebuffer_indexed_height * scale);
+    if(!framebuffer_clip(&x1, &y1, &x2, &y2, clip))
+        return;
+
+    framebuffer_resolve_args args = {framebuffer_indexed, framebuffer_indexed_width, x, y, x1, x2, scale};
+    if(scale > 1 && upscale_filter != UPSCALE_NEAREST && upscale_filter_supports(upscale_filter, scale))
+    {
+        //The filtered image is already at output size, so it resolves 1:1
+        args.src = framebuffer_filter_indexed(scale);
+        args.src_width = framebuffer_indexed_width * scale;
+        args.scale = 1;
+    }
+
+    jobs_run_bands(framebuffer_resolve_band, &args, y1, y2);
+}
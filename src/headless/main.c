@@ -0,0 +1,202 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "main.h"
+
+#ifdef HEADLESS_BUILD
+
+#include <string.h>
+
+#include "useful.h"
+#include "assets.h"
+#include "screen.h"
+#include "sound.h"
+#include "input.h"
+#include "map.h"
+#include "ui.h"
+#include "framebuffer.h"
+#include "jobs.h"
+#include "timing.h"
+#include "frame.h"
+#include "profile.h"
+#include "replay.h"
+
+/*
+ * A platform with no display, no input and no audio. Frames are drawn
+ * into the framebuffer's own memory and one game tick runs per frame with
+ * no pacing, so a run takes as long as the work does. For benchmarking
+ * and smoke testing on machines without a screen.
+ */
+
+void render(int x, int y);
+void render_pre();
+void render_post();
+void render_flip_buffers();
+bool headless_capture(const char *path);
+
+int headless_frames = 600;
+int headless_map = -1;
+char *headless_capture_path = NULL;
+char *headless_replay_path = NULL;
+
+int main(int argc, char **argv)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        if(!strcmp(argv[i], "--frames") && i+1 < argc)
+            headless_frames = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--map") && i+1 < argc)
+            headless_map = atoi(argv[++i]);
+        //--replay <file> plays back a recorded run to its end, whatever --frames says
+        else if(!strcmp(argv[i], "--replay") && i+1 < argc)
+            headless_replay_path = argv[++i];
+        //--capture <file> saves the last frame drawn as a PPM
+        else if(!strcmp(argv[i], "--capture") && i+1 < argc)
+            headless_capture_path = argv[++i];
+#ifdef PROFILE_ENABLED
+        else if(!strcmp(argv[i], "--trace") && i+1 < argc)
+            profile_trace_open(argv[++i]);
+#endif
+    }
+
+    framebuffer_init(HEADLESS_WIDTH, HEADLESS_HEIGHT);
+    frame_init();
+    jobs_init(0);
+
+    ui_init(0, 0, HEADLESS_WIDTH, HEADLESS_HEIGHT, false);
+    ui_set_draw_scale(1);
+
+    //Runs should be repeatable
+    bool replaying = headless_replay_path && replay_play_start(headless_replay_path);
+    if(!replaying)
+        replay_seed(0);
+    sound_init();
+    if (!load_resources())
+    {
+        sound_exit();
+        Quit(-1);
+    }
+
+    if(headless_map >= 0 && headless_map < NUM_MAPS)
+    {
+        unload_map();
+        load_map(headless_map);
+    }
+
+    int presented = 0;
+    double start = timing_now_ms();
+
+    int frames = 0;
+    for(; replaying || frames < headless_frames; frames++)
+    {
+        update_input();
+
+        //The recording ran out, stop where it stopped
+        if(replaying && replay_mode != REPLAY_PLAYING)
+            break;
+
+        int ticks = replay_ticks(1);
+        ui_update();
+
+        world_update_map_change();
+        world_run_ticks(ticks);
+
+        if(ticks)
+            reset_input_state();
+
+        presented += draw_screen();
+        PROFILE_FRAME_END();
+    }
+
+    double elapsed = timing_now_ms() - start;
+    printf("%d frames, %d presented, %u sounds in %.1f ms (%.3f ms/frame)\n", frames, presented, sound_played,
+           elapsed, frames ? elapsed / frames : 0.0);
+
+    if(headless_capture_path && !headless_capture(headless_capture_path))
+    {
+        sound_exit();
+        Quit(-1);
+    }
+
+    sound_exit();
+    Quit(0);
+    return 0;
+}
+
+//Binary PPM, the framebuffer is ARGB so alpha is dropped
+bool headless_capture(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if(!file)
+    {
+        printf("Couldn't open %s for the capture\n", path);
+        return false;
+    }
+
+    u8 *row = malloc(framebuffer_width * 3);
+    fprintf(file, "P6\n%d %d\n255\n", framebuffer_width, framebuffer_height);
+    for(int y = 0; y < framebuffer_height; y++)
+    {
+        const u32 *src = framebuffer + (y * framebuffer_pitch);
+        for(int x = 0; x < framebuffer_width; x++)
+        {
+            row[(x*3)+0] = (src[x] >> 16) & 0xFF;
+            row[(x*3)+1] = (src[x] >> 8) & 0xFF;
+            row[(x*3)+2] = src[x] & 0xFF;
+        }
+        fwrite(row, 3, framebuffer_width, file);
+    }
+
+    free(row);
+    fclose(file);
+    return true;
+}
+
+void Quit(int returnCode)
+{
+#ifdef PROFILE_ENABLED
+    profile_trace_close();
+#endif
+    replay_close();
+    jobs_shutdown();
+    exit(returnCode);
+}
+
+//Nothing to poll, the game idles unless a replay feeds it
+void update_input()
+{
+    replay_input();
+}
+
+void render_pre()
+{
+}
+
+void render_post()
+{
+    ui_render();
+}
+
+//The frame stays in the framebuffer for headless_capture
+void render_flip_buffers()
+{
+}
+
+#endif
@@ -76,7 +76,7 @@ void item_select_prompt(u16 x, u16 y, u16 item)
         draw_screen();
         reset_input_state();
         update_input();
-        usleep(1000*(1000/60));
+        screen_sleep(1000*(1000/60));
         ticks++;
     }
 
@@ -104,11 +104,11 @@ void item_select_prompt(u16 x, u16 y, u16 item)
         draw_screen();
         reset_input_state();
         update_input();
-        usleep(1000*(1000/60));
+        screen_sleep(1000*(1000/60));
         ticks++;
     }
 
-    usleep(1000*(1000/TARGET_TICK_FPS));
+    screen_sleep(1000*(1000/TARGET_TICK_FPS));
 }
 
 void read_iact()
@@ -189,7 +189,7 @@ void show_textbox(int x, int y, char *text)
         draw_screen();
         reset_input_state();
         update_input();
-        usleep(1000*(1000/60));
+        screen_sleep(1000*(1000/60));
     }
 
     while(1)
@@ -202,7 +202,7 @@ void show_textbox(int x, int y, char *text)
         draw_screen();
         reset_input_state();
         update_input();
-        usleep(1000*(1000/60));
+        screen_sleep(1000*(1000/60));
     }
 
     draw_screen();
@@ -242,8 +242,7 @@ void run_iact(u32 loc, int iact_id)
                 map_set_tile(args[2], args[0], args[1], TILE_NONE);
                 break;
             case IACT_CMD_DrawOverlayTile:
-                if(args[1] >= map_camera_y && args[0] >= map_camera_x && args[0]-map_camera_x < SCREEN_TILE_WIDTH && args[1]-map_camera_y < SCREEN_TILE_HEIGHT)
-                    tiles_high[(((args[1]-map_camera_y)+(map_get_height() < SCREEN_TILE_HEIGHT ? (SCREEN_TILE_HEIGHT - map_get_height()) / 2 : 0))*SCREEN_TILE_WIDTH)+(args[0]-map_camera_x)+(map_get_width() < SCREEN_TILE_WIDTH ? (SCREEN_TILE_WIDTH - map_get_width()) / 2 : 0)] = args[2];
+                map_draw_overlay_tile(args[0], args[1], args[2]);
                 break;
             case IACT_CMD_SayText: //TODO
                 log("Luke says: %s\n", string);
@@ -272,7 +271,7 @@ void run_iact(u32 loc, int iact_id)
                         draw_screen();
                     }
 
-                    usleep(1000*(1000/TARGET_TICK_FPS));
+                    screen_sleep(1000*(1000/TARGET_TICK_FPS));
                 }
 
                 break;
@@ -1,4 +1,5 @@
 #include "useful.h"
+#include "blit.h"
 /*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
  *
  *  DesktopAdventures is the legal property of its developers, whose names
@@ -27,6 +28,7 @@
 #endif
 
 bool load_resources();
+u32 hash_dat();
 void load_texture(u16 width, u32 data_loc, u32 texture_num);
 
 void seek(u32 location);
@@ -40,6 +42,8 @@ u16 read_short();
 u16 read_prefix();
 u8 read_byte();
 void read_bytes(void *out, size_t size);
+u32 peek_long(u32 location);
+u16 peek_short(u32 location);
 
 typedef struct izon_data
 {
@@ -56,10 +60,13 @@ typedef struct izon_data
 
 //static const u8* yodesk_palette;
 void *texture_buffers[0x2001];
+//Span lists for the 32x32 tiles in texture_buffers, NULL where there aren't any
+extern blit_spans *texture_spans[0x2001];
 u32 tile_metadata[0x2000];
 u8 ASSETS_LOADING;
 float ASSETS_PERCENT;
 izon_data **zone_data;
 u16 NUM_MAPS;
+extern u32 yodesk_hash;
 u8 load_demo;
 u8 is_yoda;
@@ -0,0 +1,71 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef BLIT_H
+#define BLIT_H
+
+#include "useful.h"
+
+//Row kernels over 8bpp palette indices, picked at compile time for the target
+#if defined(__AVX2__)
+#define BLIT_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#define BLIT_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BLIT_NEON
+#endif
+
+extern const char *blit_kernel_name;
+
+//dst = lut[src]
+void blit_expand_row(u32 *dst, const u8 *src, int count, const u32 *lut);
+//dst = lut[src] where src != 0
+void blit_masked_row(u32 *dst, const u8 *src, int count, const u32 *lut);
+//dst = blend(dst, lut[src], alpha) where src != 0
+void blit_blend_row(u32 *dst, const u8 *src, int count, const u32 *lut, u8 alpha);
+//dst = src where src != 0, for composing indexed layers
+void blit_compose_row(u8 *dst, const u8 *src, int count);
+
+/*
+ * Opaque runs of a 32x32 tile, so mostly transparent sprites only visit the
+ * pixels they cover. Each row in data is a span count followed by that many
+ * (start, length) pairs; row[] holds where each row begins.
+ */
+#define BLIT_SPANS_EMPTY  BIT(0)
+#define BLIT_SPANS_OPAQUE BIT(1)
+
+typedef struct blit_spans
+{
+    u8 flags;
+    u8 pad;
+    u16 row[32];
+    u8 data[];
+} blit_spans;
+
+blit_spans *blit_spans_build(const u8 *src);
+void blit_spans_compose(u8 *dst, int dst_pitch, const blit_spans *spans, const u8 *src);
+
+//Plain per-pixel versions, used for row tails and as the benchmark baseline
+void blit_expand_row_scalar(u32 *dst, const u8 *src, int count, const u32 *lut);
+void blit_masked_row_scalar(u32 *dst, const u8 *src, int count, const u32 *lut);
+void blit_blend_row_scalar(u32 *dst, const u8 *src, int count, const u32 *lut, u8 alpha);
+void blit_compose_row_scalar(u8 *dst, const u8 *src, int count);
+
+#endif
@@ -165,6 +165,7 @@ enum CHAR_DIRECTION
 } CHAR_DIRECTION;
 
 ichr_data **char_data;
+u16 char_count;
 chwp_entry **chwp_data;
 caux_entry **caux_data;
 
@@ -25,12 +25,12 @@ FONT_INFO;
 #define DESKADV_FONT_FONT_HEIGHT (9)
 #define DESKADV_INV_FONT_HEIGHT (10)
 
-const u8 deskAdvFontBitmaps[846];
-const FONT_INFO deskAdvFontFontInfo;
-const FONT_CHAR_INFO deskAdvFontDescriptors[94];
+extern const u8 deskAdvFontBitmaps[846];
+extern const FONT_INFO deskAdvFontFontInfo;
+extern const FONT_CHAR_INFO deskAdvFontDescriptors[94];
 
-const u8 deskAdvInvFontBitmaps[980];
-const FONT_INFO deskAdvInvFontInfo;
-const FONT_CHAR_INFO deskAdvInvFontDescriptors[94];
+extern const u8 deskAdvInvFontBitmaps[980];
+extern const FONT_INFO deskAdvInvFontInfo;
+extern const FONT_CHAR_INFO deskAdvInvFontDescriptors[94];
 
 #endif
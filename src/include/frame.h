@@ -0,0 +1,90 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "useful.h"
+#include "screen.h"
+
+/*
+ * Everything the renderer reads from game state, copied out each time
+ * draw_screen publishes. Frames go through a triple buffer, so with a
+ * separate render thread the simulation never waits on a present and
+ * the renderer always picks up the newest frame.
+ */
+typedef struct screen_frame
+{
+    u32 sequence; //0 until the slot is first captured
+    bool changed; //Something visible differs from the frame before
+
+    u32 cells;
+    u16 *tiles_low;
+    u16 *tiles_middle;
+    u16 *tiles_middle_overlay;
+    u16 *tiles_high;
+    u16 *tiles_overlay;
+
+    //Cells changed since the last frame the renderer took
+    u16 dirty_cells[SCREEN_MAX_DIRTY];
+    u16 dirty_count;
+    bool dirty_all;
+
+    u16 map_id;
+    u32 map_width;
+    u32 map_height;
+    u32 camera_x;
+    u32 camera_y;
+    u8 fade;
+
+    bool loading;
+    float loading_percent;
+
+    bool has_text;
+    char *text;
+    u32 text_size;
+    int text_x;
+    int text_y;
+
+    u8 palette[0x400];
+
+    bool has_inventory;
+    u16 inventory[0x100];
+    u16 equipped_item;
+} screen_frame;
+
+//Set once the simulation runs on its own thread
+extern bool frame_threaded;
+
+//The frame being rendered, only valid on the render thread during draw
+extern const screen_frame *frame_current;
+
+void frame_init();
+void frame_mark_changed();
+void frame_publish();
+const screen_frame *frame_acquire(bool *fresh);
+
+void frame_start_threaded();
+bool frame_on_render_thread();
+void frame_lock_world();
+bool frame_try_lock_world();
+void frame_unlock_world();
+
+#endif
@@ -0,0 +1,67 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "useful.h"
+#include "blit.h"
+
+//Pixels are native-endian 0xAARRGGBB
+#define FRAMEBUFFER_ARGB(a, r, g, b) (((u32)(a) << 24) | ((u32)(r) << 16) | ((u32)(g) << 8) | (u32)(b))
+
+//Clip rectangles are in framebuffer pixels, x2/y2 exclusive
+typedef struct framebuffer_rect
+{
+    int x1;
+    int y1;
+    int x2;
+    int y2;
+} framebuffer_rect;
+
+extern u32 *framebuffer;
+extern int framebuffer_width;
+extern int framebuffer_height;
+extern int framebuffer_pitch;
+extern u32 framebuffer_palette[0x100];
+
+//The game viewport is composed as palette indices and resolved through framebuffer_palette
+extern u8 *framebuffer_indexed;
+extern int framebuffer_indexed_width;
+extern int framebuffer_indexed_height;
+//Bumped whenever the indexed viewport is written
+extern u32 framebuffer_indexed_version;
+
+void framebuffer_init(int width, int height);
+void framebuffer_bind(u32 *pixels, int pitch);
+void framebuffer_update_palette(const u8 *palette);
+void framebuffer_fill(u32 color);
+void framebuffer_fill_rect(int x1, int y1, int x2, int y2, u32 color, const framebuffer_rect *clip);
+void framebuffer_blit_indexed(int x, int y, int width, int height, int scale, const u8 *src, u8 alpha, const framebuffer_rect *clip);
+void framebuffer_blit_spans(int x, int y, int scale, const blit_spans *spans, const u8 *src, u8 alpha, const framebuffer_rect *clip);
+void framebuffer_blit_mask(int x, int y, int width, int height, int scale, const u8 *mask, u32 color, const framebuffer_rect *clip);
+
+bool framebuffer_init_indexed(int width, int height);
+void framebuffer_clear_indexed(u8 index);
+void framebuffer_compose_indexed(int x, int y, int width, int height, const u8 *src);
+void framebuffer_copy_indexed(int x, int y, int width, int height, const u8 *src);
+void framebuffer_resolve_indexed(int x, int y, int scale, const framebuffer_rect *clip);
+
+#endif
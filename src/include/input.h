@@ -29,11 +29,13 @@ void button_move_left();
 void button_move_right();
 void button_push();
 void button_fire();
+void button_rewind();
 void drop_item(int x, int y);
 void mouse_move(int x, int y);
 void mouse_left();
 void mouse_right();
 void item_dragging(u16 item);
+void reset_input_presses();
 void reset_input_state();
 void update_input();
 
@@ -45,6 +47,7 @@ u8 BUTTON_LEFT_STATE;
 u8 BUTTON_RIGHT_STATE;
 u8 BUTTON_PUSH_STATE;
 u8 BUTTON_FIRE_STATE;
+u8 BUTTON_REWIND_STATE;
 u8 BUTTON_LCLICK_STATE;
 u8 BUTTON_RCLICK_STATE;
 
@@ -0,0 +1,38 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "useful.h"
+
+//Rows handed to one worker at a time, smaller ranges just run on the caller
+#define JOBS_MIN_BAND (32)
+#define JOBS_MAX_WORKERS (8)
+
+typedef void (*jobs_band_func)(void *arg, int y1, int y2);
+
+extern int jobs_num_workers;
+
+void jobs_init(int workers);
+void jobs_shutdown();
+void jobs_run_bands(jobs_band_func func, void *arg, int y1, int y2);
+
+#endif
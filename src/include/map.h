@@ -119,7 +119,15 @@ typedef struct izax_data_4
 void load_map(u16 map_id);
 void load_izax();
 void unload_map();
+bool map_read_zone(u16 map_id);
+void map_sync_zone();
+void map_restore(u16 map_id);
 void render_map();
+void map_mark_dirty(int x, int y);
+void map_draw_overlay_tile(int x, int y, u16 tile);
+void world_update_map_change();
+void world_tick();
+void world_run_ticks(int ticks);
 void update_world(double delta);
 
 void map_init(u16 num_maps);
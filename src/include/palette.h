@@ -23,7 +23,20 @@
 
 #include "useful.h"
 
+//Palette ranges cycled by palette_animate(), one bit per group
+#define PALETTE_ANIM_AQUAMARINE     BIT(0)
+#define PALETTE_ANIM_WHITE          BIT(1)
+#define PALETTE_ANIM_FIRE           BIT(2)
+#define PALETTE_ANIM_LIGHTS         BIT(3)
+#define PALETTE_ANIM_SLOW_LIGHTS    BIT(4)
+#define PALETTE_ANIM_SWAMP_WATER    BIT(5)
+#define PALETTE_ANIM_WATER          BIT(6)
+
+//Groups cycled by the last palette_animate()
+extern u8 palette_changed_mask;
+
 void palette_animate();
+u8 palette_anim_mask(const u8 *pixels, u32 count);
 
 //BGRA
 u8 yodesk_palette[0x400];
@@ -0,0 +1,76 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "useful.h"
+
+/*
+ * Frame phase timers. Build with PROFILE_ENABLED to get them, otherwise
+ * every PROFILE_* macro expands to nothing and profile.c is empty.
+ */
+
+enum
+{
+    PROFILE_INPUT = 0,
+    PROFILE_UI_UPDATE,
+    PROFILE_PLAYER,
+    PROFILE_IACT,
+    PROFILE_RENDER_MAP,
+    PROFILE_PALETTE,
+    PROFILE_RENDER,
+    PROFILE_UI_RENDER,
+    PROFILE_FLIP,
+    PROFILE_NUM_PHASES
+};
+
+//Frames kept for the overlay, one column each
+#define PROFILE_HISTORY (128)
+
+#ifdef PROFILE_ENABLED
+
+extern bool profile_overlay;
+extern const char *profile_phase_names[PROFILE_NUM_PHASES];
+
+void profile_begin(int phase);
+void profile_end(int phase);
+void profile_frame_end();
+void profile_draw_overlay();
+bool profile_trace_open(const char *path);
+void profile_trace_close();
+
+#define PROFILE_BEGIN(phase) profile_begin(phase)
+#define PROFILE_END(phase) profile_end(phase)
+#define PROFILE_FRAME_END() profile_frame_end()
+#define PROFILE_DRAW_OVERLAY() profile_draw_overlay()
+#define PROFILE_OVERLAY_VISIBLE() (profile_overlay)
+
+#else
+
+#define PROFILE_BEGIN(phase)
+#define PROFILE_END(phase)
+#define PROFILE_FRAME_END()
+#define PROFILE_DRAW_OVERLAY()
+#define PROFILE_OVERLAY_VISIBLE() (false)
+
+#endif
+
+#endif
@@ -0,0 +1,48 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef RENDER_GL_H
+#define RENDER_GL_H
+
+#include "useful.h"
+
+/*
+ * Tiles are packed into atlas pages instead of one texture each, so a frame
+ * is a handful of draw calls. 1024 is the largest size every GL target takes.
+ */
+#define RENDER_GL_ATLAS_SIZE (1024)
+#define RENDER_GL_ATLAS_STRIDE (RENDER_GL_ATLAS_SIZE / 32)
+#define RENDER_GL_ATLAS_TILES (RENDER_GL_ATLAS_STRIDE * RENDER_GL_ATLAS_STRIDE)
+#define RENDER_GL_ATLAS_PAGES (0x2000 / RENDER_GL_ATLAS_TILES)
+
+/*
+ * Where shaders are available (a PC_BUILD GL context), tiles are kept as 8bpp
+ * indices and looked up against a 256x1 palette texture, so palette animation
+ * costs a 1KB upload. Fixed-function targets like the 3DS bake tiles to RGBA
+ * instead, and re-bake the visible ones an animation tick touched.
+ */
+extern bool render_gl_indexed;
+
+bool render_gl_init_palette();
+void render_gl_update_palette();
+void render_gl_upload_tile(u32 tile, const u8 *indices);
+void render_gl_mark_palette(u8 mask);
+
+#endif
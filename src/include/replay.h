@@ -0,0 +1,75 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "useful.h"
+
+#define REPLAY_MAGIC (0x50524144) //DARP
+#define REPLAY_VERSION (1)
+
+enum
+{
+    REPLAY_OFF = 0,
+    REPLAY_RECORDING,
+    REPLAY_PLAYING
+};
+
+/*
+ * A replay is a header followed by one record per input poll, native-endian
+ * like save states. The game only sees input through update_input, so
+ * restoring every poll in order, along with how many ticks each main loop
+ * pass ran and the RNG seed, reproduces a run exactly. Runs of identical
+ * polls, which is most of them, share a record.
+ */
+typedef struct replay_header
+{
+    u32 magic;
+    u16 version;
+    u16 pad;
+    u32 dat_hash;
+    u32 seed;
+} replay_header;
+
+typedef struct replay_record
+{
+    u16 buttons;
+    s16 mouse_x;
+    s16 mouse_y;
+    u8 pointer;
+    u8 ticks;
+    u16 repeat;
+    u16 pad;
+} replay_record;
+
+extern int replay_mode;
+
+void replay_seed(u32 seed);
+u32 replay_rand();
+
+bool replay_record_start(const char *path, u32 seed);
+bool replay_play_start(const char *path);
+void replay_close();
+
+void replay_input();
+int replay_ticks(int ticks);
+
+#endif
@@ -0,0 +1,54 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef REWIND_H
+#define REWIND_H
+
+#include "useful.h"
+
+#ifdef _3DS
+#define REWIND_BUFFER_SIZE (0x80000)
+#else
+#define REWIND_BUFFER_SIZE (0x400000)
+#endif
+
+//A full snapshot is stored every so often so one bad delta can't take the whole history with it
+#define REWIND_KEY_INTERVAL (64)
+
+enum REWIND_RECORD_TYPE
+{
+    REWIND_RECORD_DELTA,
+    REWIND_RECORD_KEY,
+};
+
+typedef struct rewind_record
+{
+    u32 size;       //Encoded payload, not including this header or the trailer
+    u32 state_size; //Size of the state this record decodes to
+    u8 type;
+    u8 pad[3];
+} rewind_record;
+
+void rewind_init();
+void rewind_reset();
+void rewind_capture();
+bool rewind_step();
+
+#endif
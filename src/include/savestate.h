@@ -0,0 +1,90 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef SAVESTATE_H
+#define SAVESTATE_H
+
+#include "useful.h"
+#include "character.h"
+
+#define SAVESTATE_MAGIC (0x56534144) //DASV
+#define SAVESTATE_VERSION (1)
+
+#define SAVESTATE_QUICKSAVE_PATH "quicksave.sav"
+
+/*
+ * A save state is one flat native-endian block: a header, the loose
+ * globals, then the current zone's live data and one record per visited
+ * zone holding only its deltas against the DAT. Every section is 4-byte
+ * aligned so a loaded file can be used in place, with zones pointing
+ * straight into it until they next need to grow.
+ */
+typedef struct savestate_header
+{
+    u32 magic;
+    u16 version;
+    u16 num_zones;
+    u32 dat_hash;
+    u32 size;
+} savestate_header;
+
+typedef struct savestate_globals
+{
+    entity player;
+    u16 map_id;
+    u16 experience;
+    u16 equipped_item;
+    u16 inventory_count;
+    u16 map_change_to;
+    u8 map_change_reason;
+    u8 camera_locked;
+    u32 camera_x;
+    u32 camera_y;
+    u16 door_in_x;
+    u16 door_in_y;
+    u16 door_in_map;
+    u16 global_var;
+    u16 map_width;
+    u16 map_height;
+    u16 num_entities;
+    u16 num_zone_records;
+    u16 pad;
+    u8 palette[0x400];
+} savestate_globals;
+
+typedef struct savestate_zone
+{
+    u16 zone_id;
+    u16 width;
+    u16 height;
+    u16 num_objects;
+    u32 tiles_offset;
+    u32 objects_offset;
+    u32 delta_count;
+    u8 has_dense;
+    u8 pad[3];
+} savestate_zone;
+
+u32 savestate_serialize(u8 **out);
+bool savestate_apply(u8 *data, u32 size);
+bool savestate_save(const char *path);
+bool savestate_load(const char *path);
+
+#endif
@@ -20,18 +20,42 @@
 
 #include "useful.h"
 
-unsigned short tiles_low[0x100 * 0x100];
-unsigned short tiles_middle[0x100 * 0x100];
-unsigned short tiles_middle_overlay[0x100 * 0x100];
-unsigned short tiles_high[0x100 * 0x100];
-unsigned short tiles_overlay[0x100 * 0x100];
+//Sized to the viewport, SCREEN_TILE_WIDTH * SCREEN_TILE_HEIGHT cells each
+extern unsigned short *tiles_low;
+extern unsigned short *tiles_middle;
+extern unsigned short *tiles_middle_overlay;
+extern unsigned short *tiles_high;
+extern unsigned short *tiles_overlay;
+
+/*
+ * Cells of the layers above that changed since the last draw_screen.
+ * When more than SCREEN_MAX_DIRTY cells change, or the whole view moved,
+ * screen_dirty_all is set instead and the list should be ignored.
+ */
+#define SCREEN_MAX_DIRTY (0x400)
+
+//draw_screen skips frames that would come out identical, but still presents one every so many calls
+#define SCREEN_HEARTBEAT_FRAMES (60)
+
+extern u16 screen_dirty_cells[SCREEN_MAX_DIRTY];
+extern u16 screen_dirty_count;
+extern bool screen_dirty_all;
+extern bool screen_rebuild;
 
 char *active_text;
 int active_text_x;
 int active_text_y;
 
 void init_screen();
+void screen_mark_dirty(u32 index);
+void screen_mark_palette_dirty(u8 mask);
+void screen_mark_all_dirty();
+void screen_clear_dirty();
+void screen_request_present();
+void screen_publish();
+int screen_present();
 int draw_screen();
+void screen_sleep(u32 usec);
 void screen_transition_in();
 void screen_transition_out();
 
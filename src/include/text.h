@@ -0,0 +1,60 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef TEXT_H
+#define TEXT_H
+
+#include "useful.h"
+
+enum
+{
+    TEXT_FONT_DIALOG = 0,   //deskAdvFont, the speech strip
+    TEXT_FONT_INVENTORY,    //deskAdvInvFont, item labels
+    TEXT_NUM_FONTS
+};
+
+#define TEXT_NUM_GLYPHS (94)
+#define TEXT_GLYPH_WIDTH (8)
+#define TEXT_LINE_ADVANCE (10)
+
+//Laid out layouts kept around, reused round-robin
+#define TEXT_CACHE_SIZE (32)
+
+/*
+ * A string laid out in one font and wrap width, rasterized into a mask
+ * that's nonzero wherever a glyph has ink. Drawing it is one blit.
+ */
+typedef struct text_layout
+{
+    u8 font;
+    u8 num_lines;
+    u16 wrap;
+    u32 hash;
+    char *text;
+
+    u16 width;
+    u16 height;
+    u8 *mask;
+} text_layout;
+
+void text_init();
+text_layout *text_layout_get(u8 font, const char *text, u16 wrap);
+
+#endif
@@ -77,4 +77,7 @@
 //TNAME **tile_names;
 u32 tile_metadata[0x2000];
 
+//PALETTE_ANIM_* groups each tile's pixels use, so palette cycling can find affected cells
+extern u8 tile_palette_anim[0x2000];
+
 #endif
@@ -0,0 +1,46 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include "useful.h"
+
+//Frames are drawn at most this often, game ticks still run at TARGET_TICK_FPS
+#define TIMING_RENDER_FPS (60)
+
+//Ticks run back to back when behind, past this the backlog is dropped rather than caught up
+#define TIMING_MAX_TICKS_PER_FRAME (5)
+
+//Set when presenting already waits for the display's refresh
+extern bool timing_vsync;
+extern u32 timing_ticks_dropped;
+
+double timing_now_ms();
+void timing_sleep_ms(double ms);
+
+void timing_init();
+int timing_ticks_due();
+void timing_sleep_until_tick();
+void timing_render_begin();
+int timing_frame_begin();
+void timing_frame_end(bool presented);
+
+#endif
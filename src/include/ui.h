@@ -22,27 +22,68 @@
 #define DESKADV_UI_H
 
 #include "useful.h"
+#include "text.h"
+#include "framebuffer.h"
+
+//Targets are listed parents first, so the table can be resolved in one pass
+enum
+{
+    UI_TARGET_MAIN = 0,
+    UI_TARGET_WINDOW,
+    UI_TARGET_WINDOW_TITLE,
+    UI_TARGET_WINDOW_CONTENT,
+    UI_TARGET_GAME,
+    UI_NUM_TARGETS
+};
 
 typedef struct ui_render_target
 {
+    int id;
     int x;
     int y;
     int w;
     int h;
     
-    // Caching
-    u64 c;
-    int cx1,cy1,cx2,cy2;
     struct ui_render_target* parent;
 } ui_render_target;
 
+//A target resolved to absolute coordinates, rebuilt only when a target moves or the scale changes
+typedef struct ui_target_clip
+{
+    int x1, y1, x2, y2;
+
+    //Origin and clip in framebuffer pixels
+    int x, y;
+    framebuffer_rect clip;
+} ui_target_clip;
 
+//Pointer state between ui_update calls, see ui_get_pointer
+#define UI_POINTER_HELD_LEFT  BIT(0)
+#define UI_POINTER_DOWN_LEFT  BIT(1)
+#define UI_POINTER_TOUCH_HELD BIT(2)
+#define UI_POINTER_TOUCH_DOWN BIT(3)
+#define UI_POINTER_TOUCH_UP   BIT(4)
+
+
+void ui_invalidate_targets();
+const ui_target_clip *ui_get_target_clip(ui_render_target* target);
 void ui_get_target_bounds(ui_render_target* target, int* x1, int* y1, int* x2, int* y2);
 void ui_render_target_clear(ui_render_target* target, u8 r, u8 g, u8 b, u8 a);
 
+void buffer_plot_pixel(ui_render_target* target, int x, int y, u8 r, u8 g, u8 b, u8 a);
+void buffer_fill_rect(ui_render_target* target, int x1, int y1, int x2, int y2, u8 r, u8 g, u8 b, u8 a);
+void buffer_resolve_indexed(ui_render_target* target);
+void buffer_render_texture(ui_render_target* target, int x, int y, int width, int height, u8 alpha, void *buffer);
+void buffer_render_tile(ui_render_target* target, int x, int y, u8 alpha, u32 tile);
+void buffer_render_layout(ui_render_target* target, int x, int y, text_layout *layout, u8 r, u8 g, u8 b, u8 a);
+void buffer_render_text(ui_render_target* target, int x, int y, char *text);
+
 void ui_init(int x, int y, int w, int h, bool windowOnly);
 void ui_update();
 void ui_render();
+void ui_invalidate_chrome();
+u32 ui_frame_key();
+bool ui_uses_palette(u8 mask);
 
 void ui_set_mouse_abs(int x, int y);
 void ui_add_mouse_abs(int x, int y);
@@ -51,5 +92,7 @@ void ui_set_mouse_left(bool val);
 void ui_touch_down();
 void ui_touch_up();
 void ui_set_draw_scale(int scale);
+u8 ui_get_pointer(int *x, int *y);
+void ui_set_pointer(int x, int y, u8 flags);
 
 #endif // DESKADV_UI_H
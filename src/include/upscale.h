@@ -0,0 +1,47 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef UPSCALE_H
+#define UPSCALE_H
+
+#include "useful.h"
+
+//Filters for scaling the indexed viewport up to draw_scale
+enum
+{
+    UPSCALE_NEAREST = 0,
+    UPSCALE_SCALENX,    //Scale2x/3x, and 4x as 2x twice
+    UPSCALE_XBR_LITE,   //3x3 xBR corner rule at 2x, and 4x as 2x twice
+    UPSCALE_NUM_FILTERS
+};
+
+extern u8 upscale_filter;
+extern const char *upscale_filter_names[UPSCALE_NUM_FILTERS];
+
+void upscale_cycle_filter();
+bool upscale_filter_supports(u8 filter, int scale);
+
+//Nearest neighbour, count source pixels become count * scale output pixels
+void upscale_nearest_row(u32 *dst, const u8 *src, int count, int scale, const u32 *lut);
+
+//Filters a width x height indexed image into one scale times larger, dst is (width*scale) x (height*scale)
+void upscale_filter_indexed(u8 *dst, const u8 *src, int width, int height, int scale, u8 filter, const u32 *lut);
+
+#endif
@@ -23,7 +23,6 @@
 
 #ifdef PC_BUILD
     #include <stdint.h>
-    #define random_val() rand()
     typedef uint8_t u8;
     typedef uint16_t u16;
     typedef uint32_t u32;
@@ -51,7 +50,6 @@
 #elif defined _3DS
     #include <3ds.h>
     #include <stdarg.h>
-    #define random_val() rand()
 
     static inline void log(const char *fmt, ...)
     {
@@ -70,7 +68,6 @@
 #elif defined SWITCH
     #include <switch.h>
     #include <stdarg.h>
-    #define random_val() rand()
 
     static inline void log(const char *fmt, ...)
     {
@@ -97,9 +94,12 @@
         OSSleepTicks((usec/1000/1000) * (OSGetSystemInfo()->clockSpeed / 4));
         return 0;
     }
-    #define random_val() 1 //https://xkcd.com/221 (TODO)
 #endif
 
+//Seeded and owned by the engine so a run can be replayed, see replay.c
+u32 replay_rand();
+#define random_val() replay_rand()
+
 #ifdef __EMSCRIPTEN__
 int usleep(unsigned);
 #endif
@@ -0,0 +1,102 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef ZONE_H
+#define ZONE_H
+
+#include "useful.h"
+#include "objectinfo.h"
+
+/*
+ * Mutable zone state is kept as a sparse, key-sorted list of changes
+ * against the pristine zone data in the DAT. Tile planes are read
+ * straight out of the DAT until scripts have touched enough cells
+ * that a dense copy is cheaper, at which point the tile changes are
+ * collapsed into one.
+ *
+ * Reading the planes in place only applies to DAT_IN_RAM builds. Where the
+ * DAT stays on disk (Switch, Wii U, 3DS) the planes of the zone in use are
+ * read into one buffer the first time it's looked at, since a peek there
+ * is a seek and a read per tile.
+ */
+enum ZONE_DELTA_KIND
+{
+    ZONE_DELTA_LOW,     //Tile kinds match enum MAP_LAYER
+    ZONE_DELTA_MIDDLE,
+    ZONE_DELTA_HIGH,
+    ZONE_DELTA_OBJECT_VISIBLE,
+    ZONE_DELTA_OBJECT_ARG,
+    ZONE_DELTA_FLAGONCE,
+};
+
+#define ZONE_DELTA_KEY(kind, index) (((u32)(kind) << 24) | ((u32)(index) & 0xFFFFFF))
+#define ZONE_DELTA_KIND_OF(key) ((key) >> 24)
+#define ZONE_DELTA_INDEX_OF(key) ((key) & 0xFFFFFF)
+
+#define ZONE_NUM_PLANES (3)
+
+//Set while delta/dense point into a loaded save state instead of the heap
+#define ZONE_BORROWED_DELTA (1 << 0)
+#define ZONE_BORROWED_DENSE (1 << 1)
+
+typedef struct zone_delta
+{
+    u32 key;
+    u16 value;
+    u16 pad;
+} zone_delta;
+
+typedef struct zone_state
+{
+    u16 width;
+    u16 height;
+    u32 tiles_offset;   //LOW/MIDDLE/HIGH, interleaved per cell
+    u32 objects_offset;
+    u16 num_objects;
+    bool visited;
+    u8 borrowed;
+
+    zone_delta *delta;
+    u32 delta_count;
+    u32 delta_capacity;
+
+    u16 *dense;         //Same layout as the DAT planes, NULL while sparse
+} zone_state;
+
+void zone_init(u16 num_zones);
+zone_state *zone_get(u16 zone_id);
+void zone_reset(zone_state *zone);
+
+u16 zone_get_original_tile(zone_state *zone, u8 layer, u32 cell);
+u16 zone_get_tile(zone_state *zone, u8 layer, u32 cell);
+void zone_set_tile(zone_state *zone, u8 layer, u32 cell, u16 tile);
+void zone_collapse(zone_state *zone);
+
+bool zone_get_delta(zone_state *zone, u32 key, u16 *value);
+void zone_set_delta(zone_state *zone, u32 key, u16 value);
+void zone_clear_delta(zone_state *zone, u32 key);
+
+void zone_load_objects(zone_state *zone, obj_info *objects);
+void zone_store_objects(zone_state *zone, obj_info *objects);
+
+extern zone_state *zone_states;
+extern u16 zone_count;
+
+#endif
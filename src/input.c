@@ -36,6 +36,7 @@ u8 BUTTON_LEFT_STATE;
 u8 BUTTON_RIGHT_STATE;
 u8 BUTTON_PUSH_STATE;
 u8 BUTTON_FIRE_STATE;
+u8 BUTTON_REWIND_STATE;
 u8 BUTTON_LCLICK_STATE;
 u8 BUTTON_RCLICK_STATE;
 
@@ -73,6 +74,11 @@ void button_fire()
     BUTTON_FIRE_STATE = 1;
 }
 
+void button_rewind()
+{
+    BUTTON_REWIND_STATE = 1;
+}
+
 void drop_item(int x, int y)
 {
     int tile_x = x / 32;
@@ -138,6 +144,16 @@ void item_dragging(u16 item)
     CURRENT_ITEM_DRAGGED = item;
 }
 
+//Clears the one-shot input, held directions (and rewind) stay set until reset_input_state
+void reset_input_presses()
+{
+    BUTTON_PUSH_STATE = 0;
+    BUTTON_FIRE_STATE = 0;
+    BUTTON_LCLICK_STATE = 0;
+    BUTTON_RCLICK_STATE = 0;
+    MOUSE_MOVED = false;
+}
+
 void reset_input_state()
 {
     BUTTON_DOWN_STATE = 0;
@@ -146,6 +162,7 @@ void reset_input_state()
     BUTTON_RIGHT_STATE = 0;
     BUTTON_PUSH_STATE = 0;
     BUTTON_FIRE_STATE = 0;
+    BUTTON_REWIND_STATE = 0;
     BUTTON_LCLICK_STATE = 0;
     BUTTON_RCLICK_STATE = 0;
     MOUSE_MOVED = false;
@@ -0,0 +1,181 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "jobs.h"
+
+#include <stddef.h>
+
+#ifdef PC_BUILD
+#include <SDL2/SDL.h>
+#endif
+
+int jobs_num_workers = 0;
+
+#ifdef PC_BUILD
+
+/*
+ * A batch is split into bands which the workers and the calling thread pull
+ * from until none are left; the caller then waits for the stragglers.
+ */
+typedef struct jobs_batch
+{
+    jobs_band_func func;
+    void *arg;
+    int y1;
+    int band_height;
+    int num_bands;
+    int next_band;
+    int bands_done;
+    int y2;
+} jobs_batch;
+
+SDL_Thread *jobs_threads[JOBS_MAX_WORKERS];
+SDL_mutex *jobs_lock = NULL;
+SDL_cond *jobs_wake = NULL;
+SDL_cond *jobs_finished = NULL;
+jobs_batch jobs_current;
+u32 jobs_generation = 0;
+bool jobs_quit = false;
+
+//Runs bands of the current batch until it's drained, called with jobs_lock held
+static void jobs_drain()
+{
+    while(jobs_current.next_band < jobs_current.num_bands)
+    {
+        int band = jobs_current.next_band++;
+        int y1 = jobs_current.y1 + (band * jobs_current.band_height);
+        int y2 = MIN(y1 + jobs_current.band_height, jobs_current.y2);
+
+        SDL_UnlockMutex(jobs_lock);
+        jobs_current.func(jobs_current.arg, y1, y2);
+        SDL_LockMutex(jobs_lock);
+
+        if(++jobs_current.bands_done == jobs_current.num_bands)
+            SDL_CondSignal(jobs_finished);
+    }
+}
+
+static int jobs_worker(void *data)
+{
+    u32 seen = 0;
+
+    SDL_LockMutex(jobs_lock);
+    while(!jobs_quit)
+    {
+        if(seen == jobs_generation)
+        {
+            SDL_CondWait(jobs_wake, jobs_lock);
+            continue;
+        }
+
+        seen = jobs_generation;
+        jobs_drain();
+    }
+    SDL_UnlockMutex(jobs_lock);
+
+    return 0;
+}
+
+//0 picks one worker per spare core
+void jobs_init(int workers)
+{
+    if(workers <= 0)
+        workers = SDL_GetCPUCount() - 1;
+    workers = MIN(workers, JOBS_MAX_WORKERS);
+    if(workers <= 0)
+        return;
+
+    jobs_lock = SDL_CreateMutex();
+    jobs_wake = SDL_CreateCond();
+    jobs_finished = SDL_CreateCond();
+    jobs_quit = false;
+
+    for(int i = 0; i < workers; i++)
+        jobs_threads[i] = SDL_CreateThread(jobs_worker, "jobs", NULL);
+    jobs_num_workers = workers;
+}
+
+void jobs_shutdown()
+{
+    if(!jobs_num_workers)
+        return;
+
+    SDL_LockMutex(jobs_lock);
+    jobs_quit = true;
+    SDL_CondBroadcast(jobs_wake);
+    SDL_UnlockMutex(jobs_lock);
+
+    for(int i = 0; i < jobs_num_workers; i++)
+        SDL_WaitThread(jobs_threads[i], NULL);
+
+    SDL_DestroyCond(jobs_finished);
+    SDL_DestroyCond(jobs_wake);
+    SDL_DestroyMutex(jobs_lock);
+    jobs_num_workers = 0;
+}
+
+//Calls func over [y1, y2) in bands spread across the workers, returns once all are done
+void jobs_run_bands(jobs_band_func func, void *arg, int y1, int y2)
+{
+    int threads = jobs_num_workers + 1;
+    if(!jobs_num_workers || (y2 - y1) < JOBS_MIN_BAND * 2)
+    {
+        func(arg, y1, y2);
+        return;
+    }
+
+    //A couple of bands per thread so an unlucky one doesn't hold up the frame
+    int band_height = MAX(JOBS_MIN_BAND, (y2 - y1 + (threads * 2) - 1) / (threads * 2));
+
+    SDL_LockMutex(jobs_lock);
+    jobs_current.func = func;
+    jobs_current.arg = arg;
+    jobs_current.y1 = y1;
+    jobs_current.y2 = y2;
+    jobs_current.band_height = band_height;
+    jobs_current.num_bands = (y2 - y1 + band_height - 1) / band_height;
+    jobs_current.next_band = 0;
+    jobs_current.bands_done = 0;
+    jobs_generation++;
+    SDL_CondBroadcast(jobs_wake);
+
+    jobs_drain();
+    while(jobs_current.bands_done < jobs_current.num_bands)
+        SDL_CondWait(jobs_finished, jobs_lock);
+    SDL_UnlockMutex(jobs_lock);
+}
+
+#else
+
+//No thread pool on the consoles yet, bands run on the calling thread
+void jobs_init(int workers)
+{
+}
+
+void jobs_shutdown()
+{
+}
+
+void jobs_run_bands(jobs_band_func func, void *arg, int y1, int y2)
+{
+    func(arg, y1, y2);
+}
+
+#endif
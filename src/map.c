@@ -32,8 +32,11 @@
 #include "player.h"
 #include "useful.h"
 #include "palette.h"
+#include "zone.h"
+#include "rewind.h"
 #include "character.h"
 #include "objectinfo.h"
+#include "profile.h"
 
 #ifdef PC_BUILD
 #define log(f_, ...) printf((f_), __VA_ARGS__)
@@ -43,23 +46,20 @@
 #endif
 
 u32 tile_metadata[0x2000];
+u8 tile_palette_anim[0x2000];
 double world_timer = 0.0;
 
-u16 **map_tiles_low;
-u16 **map_tiles_middle;
-u16 **map_tiles_high;
 u16 *map_global_vars;
 u16 *map_temp_vars;
 u16 *map_rand_vars;
-bool **map_iact_flagonce;
 u16 *map_overlay;
 u32 map_camera_x = 0;
 u32 map_camera_y = 0;
 bool map_camera_locked = true;
 
 entity *entities[512];
-obj_info ***object_info;
-u16 *object_info_qty = NULL;
+zone_state *map_zone = NULL;
+obj_info *map_objects = NULL;
 u16 num_entities = 0;
 
 u16 width;
@@ -75,25 +75,22 @@ char obj_types[0x10][32] = {"QUEST_ITEM_SPOT", "SPAWN", "THE_FORCE", "VEHICLE_TO
 
 void map_init(u16 num_maps)
 {
-    map_tiles_low = calloc(num_maps*sizeof(u16*), 1);
-    map_tiles_middle = calloc(num_maps*sizeof(u16*), 1);
-    map_tiles_high = calloc(num_maps*sizeof(u16*), 1);
+    zone_init(num_maps);
+    rewind_init();
 
     map_global_vars = calloc(num_maps*sizeof(u16), 1);
     map_temp_vars = calloc(num_maps*sizeof(u16), 1);
     map_rand_vars = calloc(num_maps*sizeof(u16), 1);
-    map_iact_flagonce = calloc(num_maps*sizeof(bool*), 1);
-
-    object_info = calloc(num_maps*sizeof(void*), 1);
-    object_info_qty = calloc(num_maps*sizeof(u16*), 1);
 }
 
-//TODO: Try to make this a struct or something, less allocating of data that's already in our RAM buffer of the .DAT
-void load_map(u16 map_id)
+//Reads the zone header and sets up the overlay and objects, returns whether this is the first visit
+bool map_read_zone(u16 map_id)
 {
+    bool first_visit = false;
+
     id = map_id;
+    map_zone = zone_get(map_id);
 
-    init_screen();
     u32 location = zone_data[map_id]->izon_offset;
     location += 4; //IZON
 
@@ -124,63 +121,55 @@ void load_map(u16 map_id)
         map_overlay[i] = 0xFFFF;
     }
 
-    if(map_tiles_low[id] == NULL)
+    if(!map_zone->visited)
     {
-        map_tiles_low[id] = malloc(width * height * sizeof(u16));
-        map_tiles_middle[id] = malloc(width * height * sizeof(u16));
-        map_tiles_high[id] = malloc(width * height * sizeof(u16));
-        map_iact_flagonce[id] = calloc(zone_data[map_id]->num_iacts*sizeof(bool), 1);
-        for (int i = 0; i < width * height; i++)
-        {
-            map_tiles_low[id][i] = read_short();
-            map_tiles_middle[id][i] = read_short();
-            map_tiles_high[id][i] = read_short();
-
-            map_overlay[i] = 0xFFFF;
-        }
+        map_zone->width = width;
+        map_zone->height = height;
+        map_zone->tiles_offset = get_location();
 
         //Process Object Info
         if(!is_yoda)
             seek(zone_data[map_id]->htsp_offset);
+        else
+            seek_add(width * height * sizeof(u16) * ZONE_NUM_PLANES);
 
-        object_info_qty[id] = zone_data[map_id]->htsp_offset == 0 && !is_yoda ? 0 : read_short();
-        object_info[id] = malloc(object_info_qty[id] * sizeof(obj_info *));
-        for (int i = 0; i < object_info_qty[id]; i++)
-        {
-            object_info[id][i] = malloc(sizeof(obj_info));
+        map_zone->num_objects = zone_data[map_id]->htsp_offset == 0 && !is_yoda ? 0 : read_short();
+        map_zone->objects_offset = get_location();
+        map_zone->visited = true;
+        first_visit = true;
+    }
 
-            object_info[id][i]->type = read_long();
-            object_info[id][i]->x = read_short();
-            object_info[id][i]->y = read_short();
-            object_info[id][i]->visible = read_short();
-            object_info[id][i]->arg = read_short();
-        }
+    map_objects = malloc(map_zone->num_objects * sizeof(obj_info));
+    zone_load_objects(map_zone, map_objects);
+
+    return first_visit;
+}
 
+//Tiles and objects stay in the .DAT, only what scripts change is kept in the zone state
+void load_map(u16 map_id)
+{
+    init_screen();
+    if(map_read_zone(map_id))
         iact_set_trigger(IACT_TRIG_FirstEnter, 0);
-    }
-    else
-    {
-        seek_add(width * height * sizeof(u16) * 3);
-    }
 
-    for (int i = 0; i < object_info_qty[id]; i++)
+    for (int i = 0; i < map_zone->num_objects; i++)
     {
-        log("  obj_info: %s, %u, %u, %u, %x (%s?)\n", obj_types[object_info[id][i]->type], object_info[id][i]->x, object_info[id][i]->y, object_info[id][i]->visible, object_info[id][i]->arg, tile_names[object_info[id][i]->arg]);
+        log("  obj_info: %s, %u, %u, %u, %x (%s?)\n", obj_types[map_objects[i].type], map_objects[i].x, map_objects[i].y, map_objects[i].visible, map_objects[i].arg, tile_names[map_objects[i].arg]);
 
         //Display items and NPCs for debug purposes
-        switch (object_info[id][i]->type)
+        switch (map_objects[i].type)
         {
             case OBJ_ITEM:
             case OBJ_WEAPON:
-                if(object_info[id][i]->visible && map_get_tile(LAYER_MIDDLE, object_info[id][i]->x, object_info[id][i]->y) == TILE_NONE)
+                if(map_objects[i].visible && map_get_tile(LAYER_MIDDLE, map_objects[i].x, map_objects[i].y) == TILE_NONE)
                 {
-                    map_set_tile(LAYER_MIDDLE, object_info[id][i]->x, object_info[id][i]->y, object_info[id][i]->arg);
-                    object_info[id][i]->visible = false;
+                    map_set_tile(LAYER_MIDDLE, map_objects[i].x, map_objects[i].y, map_objects[i].arg);
+                    map_objects[i].visible = false;
                 }
                 break;
             case OBJ_DOOR_OUT:
-                player_entity.x = object_info[id][i]->x;
-                player_entity.y = object_info[id][i]->y;
+                player_entity.x = map_objects[i].x;
+                player_entity.y = map_objects[i].y;
                 break;
         }
     }
@@ -216,24 +205,34 @@ void unload_map()
 
     //These maps are not worth keeping in memory
     if(flags == MAP_FLAG_INTRO_SCREEN)
-    {
-        free(map_tiles_low[id]);
-        free(map_tiles_middle[id]);
-        free(map_tiles_high[id]);
+        zone_reset(map_zone);
+    else
+        zone_store_objects(map_zone, map_objects);
 
-        free(map_iact_flagonce[id]);
+    free(map_objects);
+    map_objects = NULL;
+    free(map_overlay);
 
-        map_tiles_low[id] = NULL;
+    for(int i = 0; i < num_entities; i++)
+        free(entities[i]);
 
-        for(int i = 0; i < object_info_qty[id]; i++)
-        {
-            free(object_info[id][i]);
-            object_info[id][i] = NULL;
-        }
+    num_entities = 0;
 
-        free(object_info[id]);
-        object_info[id] = NULL;
-    }
+
+}
+
+//Writes the current zone's objects back into its deltas
+void map_sync_zone()
+{
+    if(map_objects)
+        zone_store_objects(map_zone, map_objects);
+}
+
+//Swaps the current zone out for another without any transitions or triggers,
+//the caller is expected to fill in the overlay and entities afterwards
+void map_restore(u16 map_id)
+{
+    free(map_objects);
     free(map_overlay);
 
     for(int i = 0; i < num_entities; i++)
@@ -241,7 +240,8 @@ void unload_map()
 
     num_entities = 0;
 
-
+    init_screen();
+    map_read_zone(map_id);
 }
 
 void add_existing_entity(entity e)
@@ -329,7 +329,7 @@ bool map_all_entities_active_visible()
 
 bool map_is_loaded(u16 test_id)
 {
-    return map_tiles_low[test_id] == NULL;
+    return !zone_get(test_id)->visited;
 }
 
 void load_izax()
@@ -458,47 +458,171 @@ void load_izax()
     free(fourth_section);
 }
 
+//Map cells changed since the last render_map, in zone coordinates
+#define MAP_MAX_DIRTY (0x100)
+
+u32 map_dirty_cells[MAP_MAX_DIRTY];
+u16 map_dirty_count = 0;
+
+//Screen cells holding sprites or overlay tiles, restored on the next render_map
+#define MAP_MAX_DYNAMIC (0x800)
+
+u16 map_dynamic_cells[MAP_MAX_DYNAMIC];
+u16 map_dynamic_count = 0;
+
+//What the screen layers were last built against
+u16 render_id = 0xFFFF;
+u32 render_camera_x = 0;
+u32 render_camera_y = 0;
+u16 render_width = 0;
+u16 render_height = 0;
+
+void map_mark_dirty(int x, int y)
+{
+    if(map_dirty_count >= MAP_MAX_DIRTY)
+    {
+        screen_rebuild = true;
+        return;
+    }
+
+    map_dirty_cells[map_dirty_count++] = (y*width)+x;
+}
+
+static void map_set_overlay_cell(u32 index, u16 tile)
+{
+    if(map_overlay[index] == tile)
+        return;
+
+    map_overlay[index] = tile;
+    map_mark_dirty(index % width, index / width);
+}
+
+//Copies one screen cell back from the zone planes
+static void render_map_cell(int screen_x, int screen_y, int center_shift_x, int center_shift_y)
+{
+    int index = (screen_y*SCREEN_TILE_WIDTH)+screen_x;
+    int i = screen_x - center_shift_x;
+    int j = screen_y - center_shift_y;
+
+    tiles_middle_overlay[index] = TILE_NONE;
+    if(i < 0 || j < 0 || i >= SCREEN_TILE_WIDTH || j >= SCREEN_TILE_HEIGHT || i >= width || j >= height)
+    {
+        tiles_low[index] = TILE_NONE;
+        tiles_middle[index] = TILE_NONE;
+        tiles_high[index] = TILE_NONE;
+        tiles_overlay[index] = TILE_NONE;
+    }
+    else
+    {
+        tiles_low[index] = zone_get_tile(map_zone, LAYER_LOW, ((map_camera_y+j)*width)+i+map_camera_x);
+        tiles_middle[index] = zone_get_tile(map_zone, LAYER_MIDDLE, ((map_camera_y+j)*width)+i+map_camera_x);
+        tiles_high[index] = zone_get_tile(map_zone, LAYER_HIGH, ((map_camera_y+j)*width)+i+map_camera_x);
+        tiles_overlay[index] = map_overlay[((map_camera_y+j)*width)+i+map_camera_x];
+    }
+
+    screen_mark_dirty(index);
+}
+
+//Draws something over a cell until the next render_map puts the zone back
+static void render_map_dynamic(unsigned short *layer, int index, u16 tile)
+{
+    if(index < 0 || index >= SCREEN_TILE_WIDTH*SCREEN_TILE_HEIGHT)
+        return;
+
+    layer[index] = tile;
+    screen_mark_dirty(index);
+
+    if(map_dynamic_count < MAP_MAX_DYNAMIC)
+        map_dynamic_cells[map_dynamic_count++] = index;
+    else
+        screen_rebuild = true;
+}
+
+void map_draw_overlay_tile(int x, int y, u16 tile)
+{
+    if(y < map_camera_y || x < map_camera_x || x-map_camera_x >= SCREEN_TILE_WIDTH || y-map_camera_y >= SCREEN_TILE_HEIGHT)
+        return;
+
+    int center_shift_x = width < SCREEN_TILE_WIDTH ? (SCREEN_TILE_WIDTH - width) / 2 : 0;
+    int center_shift_y = height < SCREEN_TILE_HEIGHT ? (SCREEN_TILE_HEIGHT - height) / 2 : 0;
+
+    render_map_dynamic(tiles_high, ((y-map_camera_y+center_shift_y)*SCREEN_TILE_WIDTH)+(x-map_camera_x+center_shift_x), tile);
+}
+
 void render_map()
 {
     int center_shift_x = width < SCREEN_TILE_WIDTH ? (SCREEN_TILE_WIDTH - width) / 2 : 0;
     int center_shift_y = height < SCREEN_TILE_HEIGHT ? (SCREEN_TILE_HEIGHT - height) / 2 : 0;
 
-    for (int i = 0; i < object_info_qty[id]; i++)
+    for (int i = 0; i < map_zone->num_objects; i++)
     {
         //Display items and NPCs for debug purposes
-        switch (object_info[id][i]->type)
+        switch (map_objects[i].type)
         {
             case OBJ_ITEM:
             case OBJ_WEAPON:
             case OBJ_PUZZLE_NPC:
-                map_overlay[object_info[id][i]->x + ((object_info[id][i]->y + center_shift_y) * width) + center_shift_x] = object_info[id][i]->visible ? object_info[id][i]->arg : TILE_NONE;
+                map_set_overlay_cell(map_objects[i].x + ((map_objects[i].y + center_shift_y) * width) + center_shift_x, map_objects[i].visible ? map_objects[i].arg : TILE_NONE);
                 break;
         }
     }
 
-    //Clear old tiles
-    for(int i = 0; i < SCREEN_TILE_WIDTH*SCREEN_TILE_HEIGHT; i++)
+    if(render_id != id || render_camera_x != map_camera_x || render_camera_y != map_camera_y || render_width != width || render_height != height)
+        screen_rebuild = true;
+
+    if(screen_rebuild)
     {
-            tiles_low[i] = TILE_NONE;
-            tiles_middle[i] = TILE_NONE;
-            tiles_middle_overlay[i] = TILE_NONE;
-            tiles_high[i] = TILE_NONE;
-            tiles_overlay[i] = TILE_NONE;
-    }
+        //Clear old tiles
+        for(int i = 0; i < SCREEN_TILE_WIDTH*SCREEN_TILE_HEIGHT; i++)
+        {
+                tiles_low[i] = TILE_NONE;
+                tiles_middle[i] = TILE_NONE;
+                tiles_middle_overlay[i] = TILE_NONE;
+                tiles_high[i] = TILE_NONE;
+                tiles_overlay[i] = TILE_NONE;
+        }
+
+        for(int i = 0; i < SCREEN_TILE_WIDTH; i++)
+        {
+            for(int j = 0; j < SCREEN_TILE_HEIGHT; j++)
+            {
+                if(i >= width || j >= height)
+                    continue;
+
+                tiles_low[((j+center_shift_y)*SCREEN_TILE_WIDTH)+i+center_shift_x] = zone_get_tile(map_zone, LAYER_LOW, ((map_camera_y+j)*width)+i+map_camera_x);
+                tiles_middle[((j+center_shift_y)*SCREEN_TILE_WIDTH)+i+center_shift_x] = zone_get_tile(map_zone, LAYER_MIDDLE, ((map_camera_y+j)*width)+i+map_camera_x);
+                tiles_high[((j+center_shift_y)*SCREEN_TILE_WIDTH)+i+center_shift_x] = zone_get_tile(map_zone, LAYER_HIGH, ((map_camera_y+j)*width)+i+map_camera_x);
+                tiles_overlay[((j+center_shift_y)*SCREEN_TILE_WIDTH)+i+center_shift_x] = map_overlay[((map_camera_y+j)*width)+i+map_camera_x];
+            }
+        }
 
-    for(int i = 0; i < SCREEN_TILE_WIDTH; i++)
+        render_id = id;
+        render_camera_x = map_camera_x;
+        render_camera_y = map_camera_y;
+        render_width = width;
+        render_height = height;
+
+        screen_rebuild = false;
+        screen_dirty_all = true;
+    }
+    else
     {
-        for(int j = 0; j < SCREEN_TILE_HEIGHT; j++)
+        //Put back whatever was drawn over last time
+        for(int i = 0; i < map_dynamic_count; i++)
+            render_map_cell(map_dynamic_cells[i] % SCREEN_TILE_WIDTH, map_dynamic_cells[i] / SCREEN_TILE_WIDTH, center_shift_x, center_shift_y);
+
+        for(int i = 0; i < map_dirty_count; i++)
         {
-            if(i >= width || j >= height)
+            int x = map_dirty_cells[i] % width;
+            int y = map_dirty_cells[i] / width;
+            if(y < map_camera_y || x < map_camera_x || x-map_camera_x >= SCREEN_TILE_WIDTH || y-map_camera_y >= SCREEN_TILE_HEIGHT)
                 continue;
 
-            tiles_low[((j+center_shift_y)*SCREEN_TILE_WIDTH)+i+center_shift_x] = map_tiles_low[id][((map_camera_y+j)*width)+i+map_camera_x];
-            tiles_middle[((j+center_shift_y)*SCREEN_TILE_WIDTH)+i+center_shift_x] = map_tiles_middle[id][((map_camera_y+j)*width)+i+map_camera_x];
-            tiles_high[((j+center_shift_y)*SCREEN_TILE_WIDTH)+i+center_shift_x] = map_tiles_high[id][((map_camera_y+j)*width)+i+map_camera_x];
-            tiles_overlay[((j+center_shift_y)*SCREEN_TILE_WIDTH)+i+center_shift_x] = map_overlay[((map_camera_y+j)*width)+i+map_camera_x];
+            render_map_cell(x - map_camera_x + center_shift_x, y - map_camera_y + center_shift_y, center_shift_x, center_shift_y);
         }
     }
+    map_dirty_count = 0;
+    map_dynamic_count = 0;
 
     if(player_entity.y >= map_camera_y &&
        player_entity.y < (map_camera_y + SCREEN_TILE_HEIGHT) &&
@@ -506,26 +630,26 @@ void render_map()
        player_entity.x < (map_camera_x + SCREEN_TILE_WIDTH) &&
        player_entity.is_active_visible)
     {
-        tiles_middle_overlay[((player_entity.y - map_camera_y + center_shift_y)*SCREEN_TILE_WIDTH) + (player_entity.x - map_camera_x + center_shift_x)] = char_data[player_entity.char_id]->frames[player_entity.current_frame];
+        render_map_dynamic(tiles_middle_overlay, ((player_entity.y - map_camera_y + center_shift_y)*SCREEN_TILE_WIDTH) + (player_entity.x - map_camera_x + center_shift_x), char_data[player_entity.char_id]->frames[player_entity.current_frame]);
         if(player_entity.attacking)
         {
             switch (player_entity.extend_dir)
             {
                 case LEFT:
-                    tiles_middle_overlay[((player_entity.y - map_camera_y + center_shift_y) * SCREEN_TILE_WIDTH) + (player_entity.x - map_camera_x + center_shift_x - player_entity.extend_offset)] = char_data[player_entity.char_id]->frames[player_entity.extend_frame];
+                    render_map_dynamic(tiles_middle_overlay, ((player_entity.y - map_camera_y + center_shift_y) * SCREEN_TILE_WIDTH) + (player_entity.x - map_camera_x + center_shift_x - player_entity.extend_offset), char_data[player_entity.char_id]->frames[player_entity.extend_frame]);
                     break;
                 case RIGHT:
-                    tiles_middle_overlay[((player_entity.y - map_camera_y + center_shift_y) * SCREEN_TILE_WIDTH) + (player_entity.x - map_camera_x + center_shift_x + player_entity.extend_offset)] = char_data[player_entity.char_id]->frames[player_entity.extend_frame];
+                    render_map_dynamic(tiles_middle_overlay, ((player_entity.y - map_camera_y + center_shift_y) * SCREEN_TILE_WIDTH) + (player_entity.x - map_camera_x + center_shift_x + player_entity.extend_offset), char_data[player_entity.char_id]->frames[player_entity.extend_frame]);
                     break;
                 case UP:
                 case UP_LEFT:
                 case UP_RIGHT:
-                    tiles_middle_overlay[((player_entity.y - map_camera_y + center_shift_y - player_entity.extend_offset) * SCREEN_TILE_WIDTH) + (player_entity.x - map_camera_x + center_shift_x)] = char_data[player_entity.char_id]->frames[player_entity.extend_frame];
+                    render_map_dynamic(tiles_middle_overlay, ((player_entity.y - map_camera_y + center_shift_y - player_entity.extend_offset) * SCREEN_TILE_WIDTH) + (player_entity.x - map_camera_x + center_shift_x), char_data[player_entity.char_id]->frames[player_entity.extend_frame]);
                     break;
                 case DOWN:
                 case DOWN_LEFT:
                 case DOWN_RIGHT:
-                    tiles_middle_overlay[((player_entity.y - map_camera_y + center_shift_y + player_entity.extend_offset) * SCREEN_TILE_WIDTH) + (player_entity.x - map_camera_x + center_shift_x)] = char_data[player_entity.char_id]->frames[player_entity.extend_frame];
+                    render_map_dynamic(tiles_middle_overlay, ((player_entity.y - map_camera_y + center_shift_y + player_entity.extend_offset) * SCREEN_TILE_WIDTH) + (player_entity.x - map_camera_x + center_shift_x), char_data[player_entity.char_id]->frames[player_entity.extend_frame]);
                     break;
                 default:
                     break;
@@ -552,18 +676,12 @@ void render_map()
             e->x >= map_camera_x &&
             e->x < (map_camera_x + SCREEN_TILE_WIDTH))
         {
-            tiles_middle[((e->y - map_camera_y + center_shift_y)*SCREEN_TILE_WIDTH) + (e->x - map_camera_x + center_shift_x)] = char_data[e->char_id]->frames[e->current_frame];
+            render_map_dynamic(tiles_middle, ((e->y - map_camera_y + center_shift_y)*SCREEN_TILE_WIDTH) + (e->x - map_camera_x + center_shift_x), char_data[e->char_id]->frames[e->current_frame]);
 
             if(e->num_items > 0)
-                tiles_overlay[((e->y - map_camera_y + center_shift_y)*SCREEN_TILE_WIDTH) + (e->x - map_camera_x + center_shift_x)] = e->item;
+                render_map_dynamic(tiles_overlay, ((e->y - map_camera_y + center_shift_y)*SCREEN_TILE_WIDTH) + (e->x - map_camera_x + center_shift_x), e->item);
         }
     }
-
-    //Test for rendering characters
-    for(int i = 0; i < 26; i++)
-    {
-        //tiles_high[i] = char_data[id]->frames[i];
-    }
 }
 
 u32 map_get_width()
@@ -583,23 +701,23 @@ u16 map_get_id()
 
 u16 map_get_num_objects()
 {
-    return object_info_qty[id];
+    return map_zone->num_objects;
 }
 
 obj_info *map_get_object_by_id(int index)
 {
-    return object_info[id][index];
+    return &map_objects[index];
 }
 
 obj_info *map_get_object(int index, int x, int y)
 {
     int seek_index = index;
-    for(int i = 0; i < object_info_qty[id]; i++)
+    for(int i = 0; i < map_zone->num_objects; i++)
     {
-        if(object_info[id][i]->x == (u16)x && object_info[id][i]->y == (u16)y)
+        if(map_objects[i].x == (u16)x && map_objects[i].y == (u16)y)
         {
             if(seek_index == 0)
-                return object_info[id][i];
+                return &map_objects[i];
             seek_index--;
         }
     }
@@ -613,16 +731,16 @@ u16 map_get_tile(u8 layer, int x, int y)
     switch(layer)
     {
         case LAYER_LOW:
-            return map_tiles_low[id][(y*width)+x];
+            return zone_get_tile(map_zone, LAYER_LOW, (y*width)+x);
         case LAYER_MIDDLE:
             for(int i = 0; i < num_entities; i++)
             {
                 if(entities[i]->x == x && entities[i]->y == y)
                     return entities[i]->char_id;
             }
-            return map_tiles_middle[id][(y*width)+x];
+            return zone_get_tile(map_zone, LAYER_MIDDLE, (y*width)+x);
         case LAYER_HIGH:
-            return map_tiles_high[id][(y*width)+x];
+            return zone_get_tile(map_zone, LAYER_HIGH, (y*width)+x);
         default:
         case LAYER_OVERLAY:
             return map_overlay[(y*width)+x];
@@ -636,19 +754,16 @@ void map_set_tile(u8 layer, int x, int y, u16 tile)
     switch(layer)
     {
         case LAYER_LOW:
-            map_tiles_low[id][(y*width)+x] = tile;
-            break;
         case LAYER_MIDDLE:
-            map_tiles_middle[id][(y*width)+x] = tile;
-            break;
         case LAYER_HIGH:
-            map_tiles_high[id][(y*width)+x] = tile;
+            zone_set_tile(map_zone, layer, (y*width)+x, tile);
             break;
         default:
         case LAYER_OVERLAY:
             map_overlay[(y*width)+x] = tile;
             break;
     }
+    map_mark_dirty(x, y);
 }
 
 u32 map_get_meta(u8 layer, int x, int y)
@@ -729,15 +844,20 @@ void map_set_rand_var(u16 val)
 
 bool map_get_iact_flagonce(int iact_id)
 {
-    return map_iact_flagonce[id][iact_id];
+    u16 val;
+    return zone_get_delta(map_zone, ZONE_DELTA_KEY(ZONE_DELTA_FLAGONCE, iact_id), &val) && val;
 }
 
 void map_set_iact_flagonce(int iact_id, bool val)
 {
-    map_iact_flagonce[id][iact_id] = val;
+    if(val)
+        zone_set_delta(map_zone, ZONE_DELTA_KEY(ZONE_DELTA_FLAGONCE, iact_id), true);
+    else
+        zone_clear_delta(map_zone, ZONE_DELTA_KEY(ZONE_DELTA_FLAGONCE, iact_id));
 }
 
-void update_world(double delta)
+//Applies a pending map change, done every frame rather than every tick
+void world_update_map_change()
 {
     if(PLAYER_MAP_CHANGE_TO)
     {
@@ -756,10 +876,17 @@ void update_world(double delta)
 
     if(PLAYER_MAP_CHANGE_REASON != MAP_CHANGE_NONE && PLAYER_MAP_CHANGE_REASON != MAP_CHANGE_SCRIPT)
         PLAYER_MAP_CHANGE_REASON = MAP_CHANGE_NONE;
+}
 
-    //Limit our FPS so that each frame corresponds to a game tick for "Game Speed"
-    world_timer += delta;
-    if(world_timer > (1000/TARGET_TICK_FPS))
+//Advances the game by one tick, TARGET_TICK_FPS of these make up a second of "Game Speed"
+void world_tick()
+{
+    if(BUTTON_REWIND_STATE)
+    {
+        //Step back one tick per tick held
+        rewind_step();
+    }
+    else
     {
         if (BUTTON_LEFT_STATE)
             player_move(LEFT);
@@ -839,15 +966,51 @@ void update_world(double delta)
         if(map_camera_locked)
             map_update_camera(false);
 
+        PROFILE_BEGIN(PROFILE_PLAYER);
         player_update();
+        PROFILE_END(PROFILE_PLAYER);
+
+        PROFILE_BEGIN(PROFILE_IACT);
         iact_update();
+        PROFILE_END(PROFILE_IACT);
+
+        rewind_capture();
 
         if(SCREEN_FADE_LEVEL > 0)
             SCREEN_FADE_LEVEL--;
 
+        PROFILE_BEGIN(PROFILE_RENDER_MAP);
         render_map();
+        PROFILE_END(PROFILE_RENDER_MAP);
+
+        PROFILE_BEGIN(PROFILE_PALETTE);
         palette_animate();
+        screen_mark_palette_dirty(palette_changed_mask);
+        PROFILE_END(PROFILE_PALETTE);
+    }
+}
+
+//Runs a frame's worth of ticks, only the first one sees a press while held directions carry over
+void world_run_ticks(int ticks)
+{
+    for(int i = 0; i < ticks; i++)
+    {
+        world_tick();
+        reset_input_presses();
+    }
+}
+
+void update_world(double delta)
+{
+    world_update_map_change();
+
+    //Limit our FPS so that each frame corresponds to a game tick for "Game Speed"
+    world_timer += delta;
+    if(world_timer > (1000/TARGET_TICK_FPS))
+    {
+        world_tick();
         world_timer = 0.0;
     }
     draw_screen();
+    PROFILE_FRAME_END();
 }
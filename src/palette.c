@@ -292,32 +292,77 @@ void cycle_palette_range(u32* palette, int index, int num)
     palette[index] = grab;
 }
 
+typedef struct palette_anim_range
+{
+    u8 index;
+    u8 num;
+    u8 group;
+    bool every_other;
+} palette_anim_range;
+
+static const palette_anim_range palette_anim_ranges[] =
+{
+    //Aquamarine, white, and fire gradients
+    {0xA, 6, PALETTE_ANIM_AQUAMARINE, false},
+    {0xE0, 5, PALETTE_ANIM_WHITE, false},
+    {0xEE, 8, PALETTE_ANIM_FIRE, false},
+
+    //Rapidly changing lights
+    {0xCA, 2, PALETTE_ANIM_LIGHTS, false},
+    {0xCC, 2, PALETTE_ANIM_LIGHTS, false},
+    {0xCE, 2, PALETTE_ANIM_LIGHTS, false},
+
+    //Every-other changing lights
+    {0xC6, 2, PALETTE_ANIM_SLOW_LIGHTS, true},
+    {0xC8, 2, PALETTE_ANIM_SLOW_LIGHTS, true},
+
+    //Swamp water and water
+    {0xD7, 9, PALETTE_ANIM_SWAMP_WATER, true},
+    {0xE5, 9, PALETTE_ANIM_WATER, true},
+};
+
+#define PALETTE_ANIM_NUM_RANGES (sizeof(palette_anim_ranges) / sizeof(palette_anim_range))
+
 bool palette_flip_flop = false;
+u8 palette_changed_mask = 0;
+
+//Group bits for each palette index, built on first use
+u8 palette_index_groups[0x100];
+bool palette_index_groups_built = false;
 
 void palette_animate()
 {
+    palette_changed_mask = 0;
     if(!is_yoda) return;
     palette_flip_flop = !palette_flip_flop;
 
-    //Aquamarine, white, and fire gradients
-    cycle_palette_range((u32*)yodesk_palette, 0xA, 6);
-    cycle_palette_range((u32*)yodesk_palette, 0xE0, 5);
-    cycle_palette_range((u32*)yodesk_palette, 0xEE, 8);
+    for(int i = 0; i < PALETTE_ANIM_NUM_RANGES; i++)
+    {
+        if(palette_anim_ranges[i].every_other && !palette_flip_flop)
+            continue;
 
-    //Rapidly changing lights
-    cycle_palette_range((u32*)yodesk_palette, 0xCA, 2);
-    cycle_palette_range((u32*)yodesk_palette, 0xCC, 2);
-    cycle_palette_range((u32*)yodesk_palette, 0xCE, 2);
+        cycle_palette_range((u32*)yodesk_palette, palette_anim_ranges[i].index, palette_anim_ranges[i].num);
+        palette_changed_mask |= palette_anim_ranges[i].group;
+    }
+}
 
-    if(palette_flip_flop)
+//Which animated groups a run of palette indices touches
+u8 palette_anim_mask(const u8 *pixels, u32 count)
+{
+    if(!palette_index_groups_built)
     {
-        //Every-other changing lights
-        cycle_palette_range((u32*)yodesk_palette, 0xC6, 2);
-        cycle_palette_range((u32*)yodesk_palette, 0xC8, 2);
-
-        //Swamp water and water
-        cycle_palette_range((u32*)yodesk_palette, 0xD7, 9);
-        cycle_palette_range((u32*)yodesk_palette, 0xE5, 9);
+        for(int i = 0; i < PALETTE_ANIM_NUM_RANGES; i++)
+        {
+            for(int j = 0; j < palette_anim_ranges[i].num; j++)
+                palette_index_groups[palette_anim_ranges[i].index + j] |= palette_anim_ranges[i].group;
+        }
+        palette_index_groups_built = true;
     }
+
+    u8 mask = 0;
+    for(u32 i = 0; i < count; i++)
+        mask |= palette_index_groups[pixels[i]];
+
+    return mask;
 }
 
@@ -24,6 +24,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include <tname.h>
@@ -38,6 +39,14 @@
 #include "font.h"
 #include "map.h"
 #include "ui.h"
+#include "savestate.h"
+#include "framebuffer.h"
+#include "jobs.h"
+#include "upscale.h"
+#include "timing.h"
+#include "frame.h"
+#include "profile.h"
+#include "replay.h"
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
@@ -50,6 +59,8 @@ int initGL();
 int resizeWindow(int width, int height);
 void null_loop_iter();
 void loop_iter();
+int sim_thread_main(void *arg);
+void render_loop_iter();
 
 void render(int x, int y);
 void render_pre();
@@ -59,8 +70,9 @@ void render_flip_buffers();
 SDL_Window* displayWindow;
 SDL_Renderer* displayRenderer;
 SDL_RendererInfo displayRendererInfo;
+SDL_Texture* displayTexture;
+bool displayTextureLocked = false;
 SDL_Event event;
-clock_t last_time;
 
 u16 current_map = 79;
 int done = FALSE;
@@ -70,10 +82,34 @@ int sdl_left_state = 0;
 int sdl_right_state = 0;
 
 int SDL_WIDTH, SDL_HEIGHT;
+int SDL_PRESENT_SCALE = 1; //Window size multiplier, applied by SDL_RenderCopy rather than by drawing bigger
 bool win95_sim = true;
 
+//--threaded runs game ticks on their own thread, this one only handles input and draws
+bool sim_threaded = false;
+SDL_Thread *sim_thread = NULL;
+
+//--record <file> and --replay <file>
+char *replay_record_path = NULL;
+char *replay_play_path = NULL;
+
 int main(int argc, char **argv)
 {
+    for(int i = 1; i < argc; i++)
+    {
+        if(!strcmp(argv[i], "--threaded"))
+            sim_threaded = true;
+        else if(!strcmp(argv[i], "--record") && i+1 < argc)
+            replay_record_path = argv[++i];
+        else if(!strcmp(argv[i], "--replay") && i+1 < argc)
+            replay_play_path = argv[++i];
+#ifdef PROFILE_ENABLED
+        //--trace <file> writes frame phase timings for chrome://tracing
+        else if(!strcmp(argv[i], "--trace") && i+1 < argc)
+            profile_trace_open(argv[++i]);
+#endif
+    }
+
     SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
 
     SDL_WIDTH = (SCREEN_WIDTH+236+1)-2;
@@ -85,9 +121,26 @@ int main(int argc, char **argv)
         SDL_HEIGHT = 720;
     }
 
-    SDL_CreateWindowAndRenderer(SDL_WIDTH, SDL_HEIGHT, 0, &displayWindow, &displayRenderer);
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
+    SDL_SetHint(SDL_HINT_RENDER_VSYNC, "1");
+    SDL_CreateWindowAndRenderer(SDL_WIDTH*SDL_PRESENT_SCALE, SDL_HEIGHT*SDL_PRESENT_SCALE, 0, &displayWindow, &displayRenderer);
     SDL_GetRendererInfo(displayRenderer, &displayRendererInfo);
-    SDL_SetRenderDrawBlendMode(displayRenderer, SDL_BLENDMODE_BLEND);
+
+#ifdef __EMSCRIPTEN__
+    //The browser already paces the main loop
+    timing_vsync = true;
+#else
+    timing_vsync = (displayRendererInfo.flags & SDL_RENDERER_PRESENTVSYNC) != 0;
+#endif
+
+    //Mouse events come back in framebuffer coordinates whatever the window size
+    SDL_RenderSetLogicalSize(displayRenderer, SDL_WIDTH, SDL_HEIGHT);
+
+    displayTexture = SDL_CreateTexture(displayRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, SDL_WIDTH, SDL_HEIGHT);
+    SDL_SetTextureBlendMode(displayTexture, SDL_BLENDMODE_NONE);
+    framebuffer_init(SDL_WIDTH, SDL_HEIGHT);
+    frame_init();
+    jobs_init(0);
 
     ui_init(0, 0, SDL_WIDTH, SDL_HEIGHT, !win95_sim);
     ui_set_draw_scale(1);
@@ -96,7 +149,20 @@ int main(int argc, char **argv)
     emscripten_set_main_loop(null_loop_iter, 60, 1);
 #endif
 
-    srand(time(NULL));
+    if(replay_play_path)
+        replay_play_start(replay_play_path);
+    else if(replay_record_path)
+        replay_record_start(replay_record_path, (u32)time(NULL));
+    else
+        replay_seed((u32)time(NULL));
+
+    //Replays are keyed to the single-threaded loop's ticks per frame
+    if(replay_mode != REPLAY_OFF && sim_threaded)
+    {
+        printf("--threaded is ignored while recording or replaying\n");
+        sim_threaded = false;
+    }
+
     sound_init();
     resizeWindow(SCREEN_WIDTH, SCREEN_HEIGHT);
     if (!load_resources())
@@ -106,15 +172,27 @@ int main(int argc, char **argv)
         return -1;
     }
 
-    last_time = clock();
+    timing_init();
 
 #ifdef __EMSCRIPTEN__
     emscripten_set_main_loop(loop_iter, 60, 1);
 #else
+    if(sim_threaded)
+    {
+        frame_start_threaded();
+        sim_thread = SDL_CreateThread(sim_thread_main, "sim", NULL);
+    }
+
     while (!done)
     {
-        loop_iter();
+        if(sim_thread)
+            render_loop_iter();
+        else
+            loop_iter();
     }
+
+    if(sim_thread)
+        SDL_WaitThread(sim_thread, NULL);
 #endif
 
     sound_exit();
@@ -124,23 +202,31 @@ int main(int argc, char **argv)
 
 void null_loop_iter()
 {
-    render_pre();
-    render(0,0);
-    render_post();
-    render_flip_buffers();
+    draw_screen();
 }
 
 void loop_iter()
 {
-    clock_t time = clock();
-    double delta = (double)(time - last_time)/(CLOCKS_PER_SEC/1000.0);
-    last_time = time;
+    int ticks = timing_frame_begin();
 
-    reset_input_state();
+    PROFILE_BEGIN(PROFILE_INPUT);
     update_input();
+    PROFILE_END(PROFILE_INPUT);
+    ticks = replay_ticks(ticks);
+
+    PROFILE_BEGIN(PROFILE_UI_UPDATE);
     ui_update();
+    PROFILE_END(PROFILE_UI_UPDATE);
+
+    world_update_map_change();
+    world_run_ticks(ticks);
+
+    //Held keys are re-read every poll, so input is only cleared once a tick has seen it
+    if(ticks)
+        reset_input_state();
 
-    update_world(delta);
+    timing_frame_end(draw_screen());
+    PROFILE_FRAME_END();
 
 #ifdef __EMSCRIPTEN__
     if (done) {
@@ -149,6 +235,56 @@ void loop_iter()
 #endif
 }
 
+//Game ticks for --threaded, holding the world lock except while waiting for the next one
+int sim_thread_main(void *arg)
+{
+    frame_lock_world();
+    while (!done)
+    {
+        int ticks = timing_ticks_due();
+
+        world_update_map_change();
+        world_run_ticks(ticks);
+
+        if(ticks)
+        {
+            reset_input_state();
+            draw_screen();
+        }
+
+        frame_unlock_world();
+        timing_sleep_until_tick();
+        frame_lock_world();
+    }
+    frame_unlock_world();
+
+    return 0;
+}
+
+//Input and drawing for --threaded, a tick in progress only delays input, never the present
+void render_loop_iter()
+{
+    timing_render_begin();
+
+    if(frame_try_lock_world())
+    {
+        PROFILE_BEGIN(PROFILE_INPUT);
+        update_input();
+        PROFILE_END(PROFILE_INPUT);
+
+        PROFILE_BEGIN(PROFILE_UI_UPDATE);
+        ui_update();
+        PROFILE_END(PROFILE_UI_UPDATE);
+
+        //Picks up what input changed, like a dropped or equipped item
+        screen_publish();
+        frame_unlock_world();
+    }
+
+    timing_frame_end(screen_present());
+    PROFILE_FRAME_END();
+}
+
 int resizeWindow(int width, int height)
 {
     if (height == 0)
@@ -174,6 +310,23 @@ void handleKeyPress(SDL_Keysym *keysym)
              */
             //SDL_WM_ToggleFullScreen(surface);
         break;
+#ifdef PROFILE_ENABLED
+        case SDLK_F2:
+            profile_overlay = !profile_overlay;
+            screen_request_present();
+        break;
+#endif
+        case SDLK_F3:
+            upscale_cycle_filter();
+            screen_request_present();
+            printf("Upscale filter: %s\n", upscale_filter_names[upscale_filter]);
+        break;
+        case SDLK_F5:
+            savestate_save(SAVESTATE_QUICKSAVE_PATH);
+        break;
+        case SDLK_F9:
+            savestate_load(SAVESTATE_QUICKSAVE_PATH);
+        break;
         case SDLK_p:
             if(current_map < NUM_MAPS)
             {
@@ -230,6 +383,11 @@ void handleKeyDown()
     {
         button_fire();
     }
+
+    if (keystate[SDL_SCANCODE_BACKSPACE])
+    {
+        button_rewind();
+    }
 }
 
 void handleTouchEvent(SDL_TouchFingerEvent* event)
@@ -270,41 +428,40 @@ void handleMousePress()
     ui_set_mouse_left(left_state);
 }
 
-void fillScreen(char r, char g, char b, char a)
-{
-    SDL_SetRenderDrawColor(displayRenderer, r, g, b, a);
-    SDL_Rect rectGame = {0, 0, SDL_WIDTH, SDL_HEIGHT};
-    SDL_RenderFillRect(displayRenderer, &rectGame);
-    
-}
-
-void drawPixel(int x, int y, char r, char g, char b, char a)
-{
-    SDL_SetRenderDrawColor(displayRenderer, r, g, b, a);
-    SDL_RenderDrawPoint(displayRenderer, x, y);
-}
-
-void drawFillRect(int x1, int y1, int x2, int y2, char r, char g, char b, char a)
-{
-    SDL_SetRenderDrawColor(displayRenderer, r, g, b, a);
-    SDL_Rect rectGame = {x1, y1, x2-x1+1, y2-y1+1};
-    SDL_RenderFillRect(displayRenderer, &rectGame);
-}
-
 void render_flip_buffers()
 {
-    SDL_UpdateWindowSurface(displayWindow);
+    if(displayTextureLocked)
+    {
+        SDL_UnlockTexture(displayTexture);
+        framebuffer_bind(NULL, 0);
+        displayTextureLocked = false;
+    }
+    else
+    {
+        SDL_UpdateTexture(displayTexture, NULL, framebuffer, framebuffer_pitch * sizeof(u32));
+    }
+
+    SDL_RenderCopy(displayRenderer, displayTexture, NULL, NULL);
     SDL_RenderPresent(displayRenderer);
 }
 
 void Quit(int returnCode)
 {
+#ifdef PROFILE_ENABLED
+    profile_trace_close();
+#endif
+    replay_close();
+    jobs_shutdown();
     SDL_Quit();
     exit(returnCode);
 }
 
 void update_input()
 {
+    //Blocking game loops on the simulation thread poll too, but events belong to this one
+    if(!frame_on_render_thread())
+        return;
+
     while (SDL_PollEvent(&event))
     {
         switch (event.type)
@@ -324,6 +481,10 @@ void update_input()
             case SDL_FINGERUP:
                 handleTouchEvent((SDL_TouchFingerEvent*)&event);
                 break;
+            case SDL_WINDOWEVENT:
+                //Exposed, restored or resized, the compositor may have lost the last frame
+                screen_request_present();
+                break;
             case SDL_QUIT:
                 done = TRUE;
                 break;
@@ -338,10 +499,21 @@ void update_input()
 
     if(SDL_GetMouseState(NULL, NULL) & SDL_BUTTON(SDL_BUTTON_RIGHT))
         mouse_right();
+
+    replay_input();
 }
 
+//The frame is drawn straight into the streaming texture, falling back to the framebuffer copy if it can't be locked
 void render_pre()
 {
+    void *pixels;
+    int pitch;
+
+    if(!displayTextureLocked && !SDL_LockTexture(displayTexture, NULL, &pixels, &pitch))
+    {
+        framebuffer_bind(pixels, pitch / sizeof(u32));
+        displayTextureLocked = true;
+    }
 }
 
 void render_post()
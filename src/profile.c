@@ -0,0 +1,191 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "profile.h"
+
+#ifdef PROFILE_ENABLED
+
+#include <stdio.h>
+
+#include "framebuffer.h"
+#include "frame.h"
+#include "text.h"
+#include "timing.h"
+
+/*
+ * Each phase adds up its time over a frame, profile_frame_end() moves the
+ * totals into a ring of PROFILE_HISTORY frames for the overlay. With
+ * --threaded the simulation phases are added up on the other thread and
+ * a frame can catch one mid-tick, which is fine for eyeballing.
+ */
+
+#define PROFILE_PIXELS_PER_MS (4)
+#define PROFILE_GRAPH_HEIGHT (100)
+#define PROFILE_COLUMN_WIDTH (2)
+#define PROFILE_X (8)
+#define PROFILE_Y (8)
+
+bool profile_overlay = false;
+
+const char *profile_phase_names[PROFILE_NUM_PHASES] =
+{
+    "input",
+    "ui update",
+    "player",
+    "iact",
+    "render map",
+    "palette",
+    "render",
+    "ui render",
+    "flip",
+};
+
+const u32 profile_phase_colors[PROFILE_NUM_PHASES] =
+{
+    FRAMEBUFFER_ARGB(255, 0x80, 0x80, 0x80),
+    FRAMEBUFFER_ARGB(255, 0xC0, 0xC0, 0xC0),
+    FRAMEBUFFER_ARGB(255, 0x20, 0xC0, 0x20),
+    FRAMEBUFFER_ARGB(255, 0xC0, 0xC0, 0x20),
+    FRAMEBUFFER_ARGB(255, 0x20, 0x80, 0xFF),
+    FRAMEBUFFER_ARGB(255, 0xC0, 0x40, 0xC0),
+    FRAMEBUFFER_ARGB(255, 0xFF, 0x40, 0x20),
+    FRAMEBUFFER_ARGB(255, 0xFF, 0xA0, 0x20),
+    FRAMEBUFFER_ARGB(255, 0x20, 0xE0, 0xE0),
+};
+
+double profile_phase_start[PROFILE_NUM_PHASES];
+double profile_phase_ms[PROFILE_NUM_PHASES];
+
+float profile_history[PROFILE_HISTORY][PROFILE_NUM_PHASES];
+int profile_history_pos = 0;
+
+FILE *profile_trace = NULL;
+double profile_trace_origin = 0.0;
+
+void profile_begin(int phase)
+{
+    profile_phase_start[phase] = timing_now_ms();
+}
+
+void profile_end(int phase)
+{
+    double start = profile_phase_start[phase];
+    double ms = timing_now_ms() - start;
+    profile_phase_ms[phase] += ms;
+
+    //Chrome's trace_event format, microseconds since the trace was opened
+    if(profile_trace)
+    {
+        fprintf(profile_trace, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d},\n",
+                profile_phase_names[phase], (start - profile_trace_origin) * 1000.0, ms * 1000.0, frame_on_render_thread() ? 1 : 2);
+    }
+}
+
+void profile_frame_end()
+{
+    for(int i = 0; i < PROFILE_NUM_PHASES; i++)
+    {
+        profile_history[profile_history_pos][i] = (float)profile_phase_ms[i];
+        profile_phase_ms[i] = 0.0;
+    }
+
+    profile_history_pos = (profile_history_pos + 1) % PROFILE_HISTORY;
+}
+
+//Stacked phase times for the last PROFILE_HISTORY frames, oldest on the left, and a legend of averages
+void profile_draw_overlay()
+{
+    if(!profile_overlay || !framebuffer)
+        return;
+
+    int graph_w = PROFILE_HISTORY * PROFILE_COLUMN_WIDTH;
+    int legend_h = PROFILE_NUM_PHASES * TEXT_LINE_ADVANCE;
+    int bottom = PROFILE_Y + PROFILE_GRAPH_HEIGHT;
+
+    framebuffer_fill_rect(PROFILE_X - 4, PROFILE_Y - 4, PROFILE_X + graph_w + 4, bottom + legend_h + 8, FRAMEBUFFER_ARGB(192, 0, 0, 0), NULL);
+
+    double average[PROFILE_NUM_PHASES] = {0};
+    for(int i = 0; i < PROFILE_HISTORY; i++)
+    {
+        const float *frame = profile_history[(profile_history_pos + i) % PROFILE_HISTORY];
+        int x = PROFILE_X + (i * PROFILE_COLUMN_WIDTH);
+        int y = bottom;
+
+        for(int j = 0; j < PROFILE_NUM_PHASES && y > PROFILE_Y; j++)
+        {
+            int h = (int)(frame[j] * PROFILE_PIXELS_PER_MS + 0.5f);
+            if(h)
+                framebuffer_fill_rect(x, MAX(y - h, PROFILE_Y), x + PROFILE_COLUMN_WIDTH, y, profile_phase_colors[j], NULL);
+
+            y -= h;
+            average[j] += frame[j];
+        }
+    }
+
+    //The frame budget, anything poking above it misses a refresh
+    int budget_y = bottom - (int)((1000.0 / TIMING_RENDER_FPS) * PROFILE_PIXELS_PER_MS);
+    framebuffer_fill_rect(PROFILE_X, budget_y, PROFILE_X + graph_w, budget_y + 1, FRAMEBUFFER_ARGB(255, 0xFF, 0xFF, 0xFF), NULL);
+
+    for(int j = 0; j < PROFILE_NUM_PHASES; j++)
+    {
+        int y = bottom + 4 + (j * TEXT_LINE_ADVANCE);
+        int w = (int)((average[j] / PROFILE_HISTORY) * PROFILE_PIXELS_PER_MS * 4);
+
+        framebuffer_fill_rect(PROFILE_X, y, PROFILE_X + 8, y + 8, profile_phase_colors[j], NULL);
+
+        text_layout *layout = text_layout_get(TEXT_FONT_INVENTORY, profile_phase_names[j], 0);
+        framebuffer_blit_mask(PROFILE_X + 12, y, layout->width, layout->height, 1, layout->mask, FRAMEBUFFER_ARGB(255, 0xFF, 0xFF, 0xFF), NULL);
+
+        //Averages are drawn at 4x the graph's scale, most phases are well under a millisecond
+        framebuffer_fill_rect(PROFILE_X + 96, y + 2, PROFILE_X + 96 + MIN(w, graph_w - 96), y + 6, profile_phase_colors[j], NULL);
+    }
+}
+
+bool profile_trace_open(const char *path)
+{
+    profile_trace_close();
+
+    profile_trace = fopen(path, "w");
+    if(!profile_trace)
+    {
+        printf("Couldn't open trace file %s\n", path);
+        return false;
+    }
+
+    profile_trace_origin = timing_now_ms();
+    fprintf(profile_trace, "[\n");
+    fprintf(profile_trace, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"render\"}},\n");
+    fprintf(profile_trace, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"sim\"}},\n");
+    return true;
+}
+
+//A trace cut off without this still loads, the array format doesn't need its closing bracket
+void profile_trace_close()
+{
+    if(!profile_trace)
+        return;
+
+    fprintf(profile_trace, "{\"name\":\"trace_end\",\"ph\":\"i\",\"ts\":%.3f,\"pid\":1,\"tid\":1,\"s\":\"g\"}\n]\n",
+            (timing_now_ms() - profile_trace_origin) * 1000.0);
+    fclose(profile_trace);
+    profile_trace = NULL;
+}
+
+#endif
@@ -20,17 +20,20 @@
 
 #ifdef RENDER_BUFFER
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "assets.h"
 #include "screen.h"
-#include "palette.h"
-#include "font.h"
+#include "text.h"
 #include "ui.h"
+#include "framebuffer.h"
+#include "blit.h"
+#include "map.h"
+#include "tile.h"
+#include "frame.h"
 
 void buffer_clear_screen(u8 r, u8 g, u8 b, u8 a);
-void buffer_plot_pixel(ui_render_target* target, int x, int y, u8 r, u8 g, u8 b, u8 a);
-void buffer_flip_buffers();
 
 ui_render_target *render_target;
 
@@ -41,133 +44,201 @@ void render_set_target(ui_render_target* target)
 
 void render_texture(int x, int y, int width, int height, u8 alpha, void *buffer)
 {
-    if(!buffer || buffer == -1)
+    buffer_render_texture(render_target, x, y, width, height, alpha, buffer);
+}
+
+void render_text(int x, int y, char *text)
+{
+    x = 0;
+    if(y >= 288/2)
+        y -= 32;
+    else
+        y += 32;
+
+    //Wrapped lines sit 10px apart and their white strips butt up, so the backing is one rect
+    text_layout *layout = text_layout_get(TEXT_FONT_DIALOG, text, 280);
+    buffer_fill_rect(render_target, x, y, x+288, y+layout->height, 255,255,255,255);
+    buffer_render_layout(render_target, x, y, layout, 0,0,0,255);
+}
+
+//Composes a tile into the indexed viewport, resolved to ARGB later
+void render_texture_indexed(int x, int y, int width, int height, void *buffer)
+{
+    if(!buffer || buffer == (void*)-1)
         return;
 
-    for(int i = 0; i < width*height; i++)
-    {
-        u8 index = *(u8*)(buffer+i);
-        u8 r,g,b;
+    framebuffer_compose_indexed(x, y, width, height, buffer);
+}
 
-        if(!index)
-            continue;
+/*
+ * Precomposed low/middle/high blocks for the cells of the current zone. Each
+ * block remembers the three tiles it was built from, so anything that changes
+ * a cell (map_set_tile, entities standing in the middle layer) just misses.
+ */
+typedef struct render_cache_key
+{
+    u16 low;
+    u16 middle;
+    u16 high;
+} render_cache_key;
+
+u8 *render_zone_cache = NULL;
+render_cache_key *render_zone_keys = NULL;
+u16 render_zone_id = 0xFFFF;
+u32 render_zone_cells = 0;
+
+//What the indexed viewport was last composed with, anything else recomposes it all
+bool render_viewport_valid = false;
+int render_viewport_x_shift = 0;
+int render_viewport_y_shift = 0;
+u8 render_viewport_fade = 0;
+
+static void render_zone_cache_sync(const screen_frame *frame)
+{
+    u32 cells = frame->map_width * frame->map_height;
+    if(render_zone_id == frame->map_id && render_zone_cells == cells)
+        return;
 
-        if(is_yoda)
-        {
-            b = (u8) (yodesk_palette[(index * 4)]);
-            g = (u8) (yodesk_palette[(index * 4) + 1]);
-            r = (u8) (yodesk_palette[(index * 4) + 2]);
-        }
-        else
-        {
-            b = (u8) (indy_palette[(index * 4)]);
-            g = (u8) (indy_palette[(index * 4) + 1]);
-            r = (u8) (indy_palette[(index * 4) + 2]);
-        }
+    free(render_zone_cache);
+    free(render_zone_keys);
+    render_zone_cache = calloc(cells, 32 * 32);
+    render_zone_keys = malloc(cells * sizeof(render_cache_key));
 
-        buffer_plot_pixel(render_target, x+(i%width),y+(i/height),r,g,b,alpha);
-    }
+    //An all-TILE_NONE key matches the all-transparent block calloc gave us
+    memset(render_zone_keys, 0xFF, cells * sizeof(render_cache_key));
+    render_zone_id = frame->map_id;
+    render_zone_cells = cells;
+}
+
+static void render_compose_layer(u8 *block, u16 tile)
+{
+    if(tile >= 0x2001 || !texture_buffers[tile] || texture_buffers[tile] == (void*)-1)
+        return;
+
+    if(texture_spans[tile])
+        blit_spans_compose(block, 32, texture_spans[tile], texture_buffers[tile]);
+    else
+        blit_compose_row(block, texture_buffers[tile], 32 * 32);
+}
+
+//Zone cell shown at a screen cell, or -1 if it's outside the zone
+static int render_zone_cell(const screen_frame *frame, int x, int y)
+{
+    int width = frame->map_width, height = frame->map_height;
+    int center_shift_x = width < SCREEN_TILE_WIDTH ? (SCREEN_TILE_WIDTH - width) / 2 : 0;
+    int center_shift_y = height < SCREEN_TILE_HEIGHT ? (SCREEN_TILE_HEIGHT - height) / 2 : 0;
+
+    int zone_x = x - center_shift_x + frame->camera_x;
+    int zone_y = y - center_shift_y + frame->camera_y;
+    if(zone_x < 0 || zone_y < 0 || zone_x >= width || zone_y >= height)
+        return -1;
+
+    return (zone_y * width) + zone_x;
 }
 
-int render_char(int x, int y, char c)
+static void render_compose_cell(const screen_frame *frame, int x, int y, int x_shift, int y_shift)
 {
-    if(c == ' ')
-        return deskAdvFontFontInfo.space_width+1;
+    int index = (y * SCREEN_TILE_WIDTH) + x;
+    render_cache_key key = {frame->tiles_low[index], frame->tiles_middle[index], frame->tiles_high[index]};
+    int zone_cell = frame->tiles_middle_overlay[index] == TILE_NONE ? render_zone_cell(frame, x, y) : -1;
 
-    int offset = deskAdvFontDescriptors[c-deskAdvFontFontInfo.start_char].offset;
-    for(int i = 0; i < deskAdvFontDescriptors[c-deskAdvFontFontInfo.start_char].width; i++)
+    u8 scratch[32 * 32];
+    u8 *block = scratch;
+    if(zone_cell >= 0)
     {
-        for(int j = 0; j < DESKADV_FONT_FONT_HEIGHT; j++)
+        block = render_zone_cache + (zone_cell * 32 * 32);
+
+        render_cache_key *cached = &render_zone_keys[zone_cell];
+        if(cached->low == key.low && cached->middle == key.middle && cached->high == key.high)
         {
-            if(deskAdvFontBitmaps[offset+j] & (1<<(7-i)))
-                buffer_plot_pixel(render_target, x+i,y+j,0,0,0,255);
+            framebuffer_copy_indexed((32 * x)+x_shift, (32 * y)+y_shift, 32, 32, block);
+            return;
         }
+        *cached = key;
     }
-    return deskAdvFontDescriptors[c-deskAdvFontFontInfo.start_char].width+1;
+
+    memset(block, 0, 32 * 32);
+    render_compose_layer(block, key.low);
+    render_compose_layer(block, key.middle);
+    if(zone_cell < 0)
+        render_compose_layer(block, frame->tiles_middle_overlay[index]);
+    render_compose_layer(block, key.high);
+
+    framebuffer_copy_indexed((32 * x)+x_shift, (32 * y)+y_shift, 32, 32, block);
 }
 
-void render_text(int x, int y, char *text)
+//Brings the indexed viewport up to date, only touching cells marked dirty when possible
+static void render_compose_viewport(const screen_frame *frame, int x_shift, int y_shift)
 {
-    x = 0;
-    if(y >= 288/2)
-        y -= 32;
-    else
-        y += 32;
-    for(int i = 0; i < 288; i++)
+    render_zone_cache_sync(frame);
+
+    int fade = frame->fade;
+    if(framebuffer_init_indexed(SCREEN_WIDTH, SCREEN_HEIGHT) || !render_viewport_valid || frame->dirty_all
+       || x_shift != render_viewport_x_shift || y_shift != render_viewport_y_shift || fade != render_viewport_fade)
     {
-        for(int j = 0; j < DESKADV_FONT_FONT_HEIGHT; j++)
-        {
-            buffer_plot_pixel(render_target, x+i,y+j,255,255,255,255);
+        framebuffer_clear_indexed(0);
+        for (int y = fade; y < SCREEN_TILE_HEIGHT-fade; y++) {
+            for (int x = fade; x < SCREEN_TILE_WIDTH-fade; x++) {
+                render_compose_cell(frame, x, y, x_shift, y_shift);
+            }
         }
+
+        render_viewport_valid = true;
+        render_viewport_x_shift = x_shift;
+        render_viewport_y_shift = y_shift;
+        render_viewport_fade = fade;
+        return;
     }
 
-    for(int i = 0; i < strlen(text); i++)
+    for(int i = 0; i < frame->dirty_count; i++)
     {
-        if(x > 280)
-        {
-            x = 0;
-            y += 10;
-            for(int i = 0; i < 288; i++)
-            {
-                for(int j = 0; j < DESKADV_FONT_FONT_HEIGHT+1; j++)
-                {
-                    buffer_plot_pixel(render_target, x+i,y+j-1,255,255,255,255);
-                }
-            }
-        }
-        x += render_char(x,y,text[i]);
+        int x = frame->dirty_cells[i] % SCREEN_TILE_WIDTH;
+        int y = frame->dirty_cells[i] / SCREEN_TILE_WIDTH;
+        if(x < fade || y < fade || x >= SCREEN_TILE_WIDTH-fade || y >= SCREEN_TILE_HEIGHT-fade)
+            continue;
+
+        render_compose_cell(frame, x, y, x_shift, y_shift);
     }
 }
 
+//Draws frame_current, never the live game state, so it can run beside the simulation
 void render(int x_shift, int y_shift)
 {
+    const screen_frame *frame = frame_current;
     buffer_clear_screen(0,0,0,255);
 
-    if (ASSETS_LOADING)
+    if (frame->loading)
     {
+        framebuffer_init_indexed(SCREEN_WIDTH, SCREEN_HEIGHT);
+        framebuffer_clear_indexed(0);
+        render_viewport_valid = false;
+
         int x_center = 9 < SCREEN_TILE_WIDTH ? ((SCREEN_TILE_WIDTH - 9) / 2)*32 : 0;
         int y_center = 9 < SCREEN_TILE_HEIGHT ? ((SCREEN_TILE_HEIGHT - 9) / 2)*32 : 0;
-        render_texture(x_center + x_shift,y_center + y_shift,288,288,255,texture_buffers[0x2000]);
+        render_texture_indexed(x_center + x_shift,y_center + y_shift,288,288,texture_buffers[0x2000]);
+        buffer_resolve_indexed(render_target);
 
         int bar_x = 8;
         int bar_y = 264;
-        for(int i = 0; i < (int)(278.0f*ASSETS_PERCENT); i++)
-        {
-            for(int j = 0; j < 16; j++)
-            {
-                buffer_plot_pixel(render_target, x_center+x_shift+bar_x+i,y_center+y_shift+bar_y+j,0,0,128,255);
-            }
-        }
+        buffer_fill_rect(render_target, x_center+x_shift+bar_x, y_center+y_shift+bar_y, x_center+x_shift+bar_x+(int)(278.0f*frame->loading_percent), y_center+y_shift+bar_y+16, 0,0,128,255);
     }
     else
     {
-        for (int y = SCREEN_FADE_LEVEL; y < SCREEN_TILE_HEIGHT-SCREEN_FADE_LEVEL; y++) {
-            for (int x = SCREEN_FADE_LEVEL; x < SCREEN_TILE_WIDTH-SCREEN_FADE_LEVEL; x++) {
-                if (tiles_low[(y * SCREEN_TILE_WIDTH) + x] != 0xFFFF) {
-                    render_texture((32 * x)+x_shift, (32 * y)+y_shift, 32, 32, 255, texture_buffers[tiles_low[(y * SCREEN_TILE_WIDTH) + x]]);
-                }
-
-                if (tiles_middle[(y * SCREEN_TILE_WIDTH) + x] != 0xFFFF) {
-                    render_texture((32 * x)+x_shift, (32 * y)+y_shift, 32, 32, 255, texture_buffers[tiles_middle[(y * SCREEN_TILE_WIDTH) + x]]);
-                }
-
-                if (tiles_middle_overlay[(y * SCREEN_TILE_WIDTH) + x] != 0xFFFF) {
-                    render_texture((32 * x)+x_shift, (32 * y)+y_shift, 32, 32, 255, texture_buffers[tiles_middle_overlay[(y * SCREEN_TILE_WIDTH) + x]]);
-                }
-
-                if (tiles_high[(y * SCREEN_TILE_WIDTH) + x] != 0xFFFF) {
-                    render_texture((32 * x)+x_shift, (32 * y)+y_shift, 32, 32, 255, texture_buffers[tiles_high[(y * SCREEN_TILE_WIDTH) + x]]);
-                }
-
-                if (tiles_overlay[(y * SCREEN_TILE_WIDTH) + x] != 0xFFFF) {
-                    render_texture((32 * x)+x_shift, (32 * y)+y_shift, 32, 32, 153, texture_buffers[tiles_overlay[(y * SCREEN_TILE_WIDTH) + x]]);
+        render_compose_viewport(frame, x_shift, y_shift);
+        buffer_resolve_indexed(render_target);
+
+        //The overlay is translucent, so it's blended over the resolved frame
+        for (int y = frame->fade; y < SCREEN_TILE_HEIGHT-frame->fade; y++) {
+            for (int x = frame->fade; x < SCREEN_TILE_WIDTH-frame->fade; x++) {
+                if (frame->tiles_overlay[(y * SCREEN_TILE_WIDTH) + x] != 0xFFFF) {
+                    buffer_render_tile(render_target, (32 * x)+x_shift, (32 * y)+y_shift, 153, frame->tiles_overlay[(y * SCREEN_TILE_WIDTH) + x]);
                 }
             }
         }
     }
 
-    if(active_text)
-        render_text(active_text_x+x_shift,active_text_y+y_shift,active_text);
+    if(frame->has_text)
+        render_text(frame->text_x+x_shift,frame->text_y+y_shift,frame->text);
 }
 
 #endif
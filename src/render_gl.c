@@ -25,8 +25,285 @@
 #else
     #include <GL/gl.h>
 #endif
+#include <stdlib.h>
+#include <string.h>
 #include "assets.h"
 #include "screen.h"
+#include "render_gl.h"
+#include "palette.h"
+#include "tile.h"
+
+typedef struct render_gl_vertex
+{
+    GLfloat x;
+    GLfloat y;
+    GLfloat u;
+    GLfloat v;
+} render_gl_vertex;
+
+GLuint render_gl_atlas[RENDER_GL_ATLAS_PAGES];
+
+//Six vertices per cell, grouped by atlas page
+render_gl_vertex *render_gl_batch = NULL;
+u32 render_gl_batch_cells = 0;
+
+bool render_gl_indexed = false;
+bool render_gl_palette_tried = false;
+GLuint render_gl_palette;
+
+//Baked tiles whose animated colors have moved on since they were uploaded
+u8 render_gl_tile_stale[0x2000];
+u8 render_gl_stale_mask = 0;
+
+#ifdef PC_BUILD
+GLuint render_gl_program;
+
+PFNGLCREATESHADERPROC pglCreateShader;
+PFNGLSHADERSOURCEPROC pglShaderSource;
+PFNGLCOMPILESHADERPROC pglCompileShader;
+PFNGLGETSHADERIVPROC pglGetShaderiv;
+PFNGLCREATEPROGRAMPROC pglCreateProgram;
+PFNGLATTACHSHADERPROC pglAttachShader;
+PFNGLLINKPROGRAMPROC pglLinkProgram;
+PFNGLGETPROGRAMIVPROC pglGetProgramiv;
+PFNGLUSEPROGRAMPROC pglUseProgram;
+PFNGLGETUNIFORMLOCATIONPROC pglGetUniformLocation;
+PFNGLUNIFORM1IPROC pglUniform1i;
+PFNGLACTIVETEXTUREPROC pglActiveTexture;
+
+static const char *render_gl_vertex_source =
+    "void main()\n"
+    "{\n"
+    "    gl_Position = ftransform();\n"
+    "    gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+    "    gl_FrontColor = gl_Color;\n"
+    "}\n";
+
+//Index 0 is transparent, everything else is looked up in the palette row
+static const char *render_gl_fragment_source =
+    "uniform sampler2D atlas;\n"
+    "uniform sampler2D palette;\n"
+    "void main()\n"
+    "{\n"
+    "    float index = texture2D(atlas, gl_TexCoord[0].st).r;\n"
+    "    if(index == 0.0)\n"
+    "        discard;\n"
+    "    vec4 color = texture2D(palette, vec2(((index * 255.0) + 0.5) / 256.0, 0.5));\n"
+    "    gl_FragColor = vec4(color.rgb, gl_Color.a);\n"
+    "}\n";
+
+static GLuint render_gl_compile(GLenum type, const char *source)
+{
+    GLint ok = 0;
+    GLuint shader = pglCreateShader(type);
+    pglShaderSource(shader, 1, &source, NULL);
+    pglCompileShader(shader);
+    pglGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+
+    return ok ? shader : 0;
+}
+#endif
+
+//Tries to set up the palette shader once, false keeps tiles in RGBA
+bool render_gl_init_palette()
+{
+    if(render_gl_palette_tried)
+        return render_gl_indexed;
+    render_gl_palette_tried = true;
+
+#ifdef PC_BUILD
+    pglCreateShader = SDL_GL_GetProcAddress("glCreateShader");
+    pglShaderSource = SDL_GL_GetProcAddress("glShaderSource");
+    pglCompileShader = SDL_GL_GetProcAddress("glCompileShader");
+    pglGetShaderiv = SDL_GL_GetProcAddress("glGetShaderiv");
+    pglCreateProgram = SDL_GL_GetProcAddress("glCreateProgram");
+    pglAttachShader = SDL_GL_GetProcAddress("glAttachShader");
+    pglLinkProgram = SDL_GL_GetProcAddress("glLinkProgram");
+    pglGetProgramiv = SDL_GL_GetProcAddress("glGetProgramiv");
+    pglUseProgram = SDL_GL_GetProcAddress("glUseProgram");
+    pglGetUniformLocation = SDL_GL_GetProcAddress("glGetUniformLocation");
+    pglUniform1i = SDL_GL_GetProcAddress("glUniform1i");
+    pglActiveTexture = SDL_GL_GetProcAddress("glActiveTexture");
+
+    if(!pglCreateShader || !pglShaderSource || !pglCompileShader || !pglGetShaderiv || !pglCreateProgram || !pglAttachShader
+       || !pglLinkProgram || !pglGetProgramiv || !pglUseProgram || !pglGetUniformLocation || !pglUniform1i || !pglActiveTexture)
+        return false;
+
+    GLuint vertex = render_gl_compile(GL_VERTEX_SHADER, render_gl_vertex_source);
+    GLuint fragment = render_gl_compile(GL_FRAGMENT_SHADER, render_gl_fragment_source);
+    if(!vertex || !fragment)
+        return false;
+
+    GLint ok = 0;
+    render_gl_program = pglCreateProgram();
+    pglAttachShader(render_gl_program, vertex);
+    pglAttachShader(render_gl_program, fragment);
+    pglLinkProgram(render_gl_program);
+    pglGetProgramiv(render_gl_program, GL_LINK_STATUS, &ok);
+    if(!ok)
+        return false;
+
+    pglUseProgram(render_gl_program);
+    pglUniform1i(pglGetUniformLocation(render_gl_program, "atlas"), 0);
+    pglUniform1i(pglGetUniformLocation(render_gl_program, "palette"), 1);
+    pglUseProgram(0);
+
+    glGenTextures(0x1, &render_gl_palette);
+    glBindTexture(GL_TEXTURE_2D, render_gl_palette);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0x100, 1, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    render_gl_indexed = true;
+    render_gl_update_palette();
+#endif
+
+    return render_gl_indexed;
+}
+
+//The palette is stored BGRA, so it uploads as-is
+void render_gl_update_palette()
+{
+#ifdef PC_BUILD
+    if(!render_gl_indexed)
+        return;
+
+    glBindTexture(GL_TEXTURE_2D, render_gl_palette);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0x100, 1, GL_BGRA, GL_UNSIGNED_BYTE, is_yoda ? yodesk_palette : indy_palette);
+#endif
+}
+
+//Without the palette shader, tiles are baked against the palette as it is right now
+static void render_gl_bake_tile(const u8 *indices, u32 *out)
+{
+    const u8 *palette = is_yoda ? yodesk_palette : indy_palette;
+
+    for(int i = 0; i < 32*32; i++)
+    {
+        const u8 *entry = &palette[indices[i] * 4];
+        out[i] = ((u32)entry[0] << 16) | ((u32)entry[1] << 8) | (u32)entry[2];
+        if(indices[i])
+            out[i] |= 0xFF000000; //Make sure it's not transparent
+    }
+}
+
+//Takes the tile's palette indices, which are uploaded as-is or baked first
+void render_gl_upload_tile(u32 tile, const u8 *indices)
+{
+    u32 page = tile / RENDER_GL_ATLAS_TILES;
+    u32 slot = tile % RENDER_GL_ATLAS_TILES;
+
+    if(!render_gl_atlas[page])
+    {
+        glGenTextures(0x1, &render_gl_atlas[page]);
+        glBindTexture(GL_TEXTURE_2D, render_gl_atlas[page]);
+        if(render_gl_indexed)
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, RENDER_GL_ATLAS_SIZE, RENDER_GL_ATLAS_SIZE, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, NULL);
+        else
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, RENDER_GL_ATLAS_SIZE, RENDER_GL_ATLAS_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    static u32 baked[32*32];
+    const void *pixels = indices;
+    if(!render_gl_indexed)
+    {
+        render_gl_bake_tile(indices, baked);
+        pixels = baked;
+        render_gl_tile_stale[tile] = 0;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, render_gl_atlas[page]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % RENDER_GL_ATLAS_STRIDE) * 32, (slot / RENDER_GL_ATLAS_STRIDE) * 32, 32, 32,
+                    render_gl_indexed ? GL_LUMINANCE : GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+//Called for every palette tick, baked tiles using those colors are re-uploaded once they're next drawn
+void render_gl_mark_palette(u8 mask)
+{
+    if(!render_gl_indexed)
+        render_gl_stale_mask |= mask;
+}
+
+static void render_gl_mark_stale()
+{
+    if(!render_gl_stale_mask)
+        return;
+
+    for(int i = 0; i < 0x2000; i++)
+    {
+        if(tile_palette_anim[i] & render_gl_stale_mask)
+            render_gl_tile_stale[i] = 1;
+    }
+    render_gl_stale_mask = 0;
+}
+
+static void render_gl_quad(render_gl_vertex *out, int x, int y, u16 tile)
+{
+    u32 slot = tile % RENDER_GL_ATLAS_TILES;
+    GLfloat u1 = (GLfloat)((slot % RENDER_GL_ATLAS_STRIDE) * 32) / RENDER_GL_ATLAS_SIZE;
+    GLfloat v1 = (GLfloat)((slot / RENDER_GL_ATLAS_STRIDE) * 32) / RENDER_GL_ATLAS_SIZE;
+    GLfloat u2 = u1 + (32.0f / RENDER_GL_ATLAS_SIZE);
+    GLfloat v2 = v1 + (32.0f / RENDER_GL_ATLAS_SIZE);
+
+    render_gl_vertex quad[6] =
+    {
+        {x, y, u1, v1}, {x + 32, y, u2, v1}, {x + 32, y + 32, u2, v2},
+        {x, y, u1, v1}, {x + 32, y + 32, u2, v2}, {x, y + 32, u1, v2},
+    };
+    memcpy(out, quad, sizeof(quad));
+}
+
+//Emits every visible cell of a layer and draws it with one call per atlas page
+static void render_gl_layer(unsigned short *layer)
+{
+    u32 page_count[RENDER_GL_ATLAS_PAGES] = {0};
+    u32 page_start[RENDER_GL_ATLAS_PAGES];
+
+    for (int y = SCREEN_FADE_LEVEL; y < SCREEN_TILE_HEIGHT-SCREEN_FADE_LEVEL; y++) {
+        for (int x = SCREEN_FADE_LEVEL; x < SCREEN_TILE_WIDTH-SCREEN_FADE_LEVEL; x++) {
+            u16 tile = layer[(y * SCREEN_TILE_WIDTH) + x];
+            if (tile >= 0x2000)
+                continue;
+
+            if (render_gl_tile_stale[tile] && texture_buffers[tile])
+                render_gl_upload_tile(tile, texture_buffers[tile]);
+            page_count[tile / RENDER_GL_ATLAS_TILES]++;
+        }
+    }
+
+    u32 total = 0;
+    for(int i = 0; i < RENDER_GL_ATLAS_PAGES; i++)
+    {
+        page_start[i] = total;
+        total += page_count[i];
+    }
+    if(!total)
+        return;
+
+    u32 page_fill[RENDER_GL_ATLAS_PAGES];
+    memcpy(page_fill, page_start, sizeof(page_fill));
+    for (int y = SCREEN_FADE_LEVEL; y < SCREEN_TILE_HEIGHT-SCREEN_FADE_LEVEL; y++) {
+        for (int x = SCREEN_FADE_LEVEL; x < SCREEN_TILE_WIDTH-SCREEN_FADE_LEVEL; x++) {
+            u16 tile = layer[(y * SCREEN_TILE_WIDTH) + x];
+            if (tile < 0x2000)
+                render_gl_quad(&render_gl_batch[page_fill[tile / RENDER_GL_ATLAS_TILES]++ * 6], 32 * x, 32 * y, tile);
+        }
+    }
+
+    glVertexPointer(2, GL_FLOAT, sizeof(render_gl_vertex), &render_gl_batch[0].x);
+    glTexCoordPointer(2, GL_FLOAT, sizeof(render_gl_vertex), &render_gl_batch[0].u);
+    for(int i = 0; i < RENDER_GL_ATLAS_PAGES; i++)
+    {
+        if(!page_count[i])
+            continue;
+
+        glBindTexture(GL_TEXTURE_2D, render_gl_atlas[i]);
+        glDrawArrays(GL_TRIANGLES, page_start[i] * 6, page_count[i] * 6);
+    }
+}
 
 void render(int x, int y)
 {
@@ -82,90 +359,47 @@ void render(int x, int y)
     }
     else
     {
-        for (int y = SCREEN_FADE_LEVEL; y < SCREEN_TILE_HEIGHT-SCREEN_FADE_LEVEL; y++) {
-            for (int x = SCREEN_FADE_LEVEL; x < SCREEN_TILE_WIDTH-SCREEN_FADE_LEVEL; x++) {
-                if (tiles_low[(y * SCREEN_TILE_WIDTH) + x] != 0xFFFF) {
-                    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-                    glBindTexture(GL_TEXTURE_2D, texture[tiles_low[(y * SCREEN_TILE_WIDTH) + x]]);
-                    glBegin(GL_QUADS);
-                    {
-                        glTexCoord2f(1.0f, 1.0f);
-                        glVertex2f(32 * x, 32 * y);
-
-                        glTexCoord2f(0.0f, 1.0f);
-                        glVertex2f((32 * x) + 32, 32 * y);
-
-                        glTexCoord2f(0.0f, 0.0f);
-                        glVertex2f((32 * x) + 32, (32 * y) + 32);
-
-                        glTexCoord2f(1.0f, 0.0f);
-                        glVertex2f(32 * x, (32 * y) + 32);
-                    }
-                    glEnd();
-                }
-
-                if (tiles_middle[(y * SCREEN_TILE_WIDTH) + x] != 0xFFFF) {
-                    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-                    glBindTexture(GL_TEXTURE_2D, texture[tiles_middle[(y * SCREEN_TILE_WIDTH) + x]]);
-                    glBegin(GL_QUADS);
-                    {
-                        glTexCoord2f(1.0f, 1.0f);
-                        glVertex2f(32 * x, 32 * y);
-
-                        glTexCoord2f(0.0f, 1.0f);
-                        glVertex2f((32 * x) + 32, 32 * y);
-
-                        glTexCoord2f(0.0f, 0.0f);
-                        glVertex2f((32 * x) + 32, (32 * y) + 32);
-
-                        glTexCoord2f(1.0f, 0.0f);
-                        glVertex2f(32 * x, (32 * y) + 32);
-                    }
-                    glEnd();
-                }
-
-                if (tiles_high[(y * SCREEN_TILE_WIDTH) + x] != 0xFFFF) {
-                    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-                    glBindTexture(GL_TEXTURE_2D, texture[tiles_high[(y * SCREEN_TILE_WIDTH) + x]]);
-                    glBegin(GL_QUADS);
-                    {
-                        glTexCoord2f(1.0f, 1.0f);
-                        glVertex2f(32 * x, 32 * y);
-
-                        glTexCoord2f(0.0f, 1.0f);
-                        glVertex2f((32 * x) + 32, 32 * y);
-
-                        glTexCoord2f(0.0f, 0.0f);
-                        glVertex2f((32 * x) + 32, (32 * y) + 32);
-
-                        glTexCoord2f(1.0f, 0.0f);
-                        glVertex2f(32 * x, (32 * y) + 32);
-                    }
-                    glEnd();
-                }
-
-                if (tiles_overlay[(y * SCREEN_TILE_WIDTH) + x] != 0xFFFF) {
-                    glColor4f(1.0f, 1.0f, 1.0f, 0.6f);
-                    glBindTexture(GL_TEXTURE_2D, texture[tiles_overlay[(y * SCREEN_TILE_WIDTH) + x]]);
-                    float scale = 1.0f;
-                    glBegin(GL_QUADS);
-                    {
-                        glTexCoord2f(1.0f, 1.0f);
-                        glVertex2f((32 * x), (32 * y));
-
-                        glTexCoord2f(0.0f, 1.0f);
-                        glVertex2f((32 * x) + (32 * scale), (32 * y));
-
-                        glTexCoord2f(0.0f, 0.0f);
-                        glVertex2f((32 * x) + (32 * scale), (32 * y) + (32 * scale));
-
-                        glTexCoord2f(1.0f, 0.0f);
-                        glVertex2f((32 * x), (32 * y) + (32 * scale));
-                    }
-                    glEnd();
-                }
-            }
+        u32 cells = SCREEN_TILE_WIDTH * SCREEN_TILE_HEIGHT;
+        if(cells > render_gl_batch_cells)
+        {
+            free(render_gl_batch);
+            render_gl_batch = malloc(cells * 6 * sizeof(render_gl_vertex));
+            render_gl_batch_cells = cells;
+        }
+
+        render_gl_mark_stale();
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+#ifdef PC_BUILD
+        if(render_gl_indexed)
+        {
+            render_gl_update_palette();
+
+            pglActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, render_gl_palette);
+            pglActiveTexture(GL_TEXTURE0);
+            pglUseProgram(render_gl_program);
         }
+#endif
+
+        glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+        render_gl_layer(tiles_low);
+        render_gl_layer(tiles_middle);
+        render_gl_layer(tiles_middle_overlay);
+        render_gl_layer(tiles_high);
+
+        glColor4f(1.0f, 1.0f, 1.0f, 0.6f);
+        render_gl_layer(tiles_overlay);
+
+#ifdef PC_BUILD
+        if(render_gl_indexed)
+            pglUseProgram(0);
+#endif
+
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
     }
 }
 
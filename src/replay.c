@@ -0,0 +1,254 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "replay.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "assets.h"
+#include "input.h"
+#include "ui.h"
+
+int replay_mode = REPLAY_OFF;
+
+//xorshift32, owned by the engine so the C library's rand() can't shift it
+u32 replay_rng = 0x2545F491;
+
+FILE *replay_file = NULL;
+u32 replay_dat_hash = 0;
+u32 replay_recorded_seed = 0;
+u32 replay_polls = 0;
+
+//Recording: the poll still waiting on its tick count, and the run it may join
+replay_record replay_pending;
+bool replay_has_pending = false;
+replay_record replay_run;
+
+//Playing: the run being fed back and how many polls it has left
+replay_record replay_current;
+u32 replay_left = 0;
+
+u8 *const replay_buttons[] =
+{
+    &BUTTON_DOWN_STATE,
+    &BUTTON_UP_STATE,
+    &BUTTON_LEFT_STATE,
+    &BUTTON_RIGHT_STATE,
+    &BUTTON_PUSH_STATE,
+    &BUTTON_FIRE_STATE,
+    &BUTTON_REWIND_STATE,
+    &BUTTON_LCLICK_STATE,
+    &BUTTON_RCLICK_STATE,
+};
+
+#define REPLAY_NUM_BUTTONS (sizeof(replay_buttons) / sizeof(replay_buttons[0]))
+
+void replay_seed(u32 seed)
+{
+    replay_rng = seed ^ 0x2545F491;
+    if(!replay_rng)
+        replay_rng = 0x2545F491;
+}
+
+u32 replay_rand()
+{
+    replay_rng ^= replay_rng << 13;
+    replay_rng ^= replay_rng >> 17;
+    replay_rng ^= replay_rng << 5;
+    return replay_rng;
+}
+
+//Started before load_resources, since loading rolls the RNG too, the header waits for the DAT hash
+bool replay_record_start(const char *path, u32 seed)
+{
+    replay_close();
+
+    replay_file = fopen(path, "wb");
+    if(!replay_file)
+    {
+        printf("Couldn't open %s to record\n", path);
+        return false;
+    }
+
+    replay_seed(seed);
+    replay_recorded_seed = seed;
+    replay_has_pending = false;
+    replay_run.repeat = 0;
+    replay_polls = 0;
+    replay_mode = REPLAY_RECORDING;
+    return true;
+}
+
+//The DAT hash is checked on the first poll, load_resources hasn't run yet when this is called
+bool replay_play_start(const char *path)
+{
+    replay_close();
+
+    replay_file = fopen(path, "rb");
+    if(!replay_file)
+    {
+        printf("Couldn't open replay %s\n", path);
+        return false;
+    }
+
+    replay_header header;
+    if(fread(&header, sizeof(header), 1, replay_file) != 1 || header.magic != REPLAY_MAGIC || header.version != REPLAY_VERSION)
+    {
+        printf("%s isn't a replay this build can play\n", path);
+        fclose(replay_file);
+        replay_file = NULL;
+        return false;
+    }
+
+    replay_seed(header.seed);
+    replay_dat_hash = header.dat_hash;
+    replay_left = 0;
+    replay_polls = 0;
+    replay_mode = REPLAY_PLAYING;
+    return true;
+}
+
+static void replay_write_header()
+{
+    replay_header header = {0};
+    header.magic = REPLAY_MAGIC;
+    header.version = REPLAY_VERSION;
+    header.dat_hash = yodesk_hash;
+    header.seed = replay_recorded_seed;
+    fwrite(&header, sizeof(header), 1, replay_file);
+}
+
+static void replay_flush_run()
+{
+    if(replay_run.repeat)
+        fwrite(&replay_run, sizeof(replay_run), 1, replay_file);
+    replay_run.repeat = 0;
+}
+
+//Identical polls are counted rather than written, only a change costs a record
+static void replay_push(replay_record *record)
+{
+    if(replay_run.repeat && replay_run.repeat < 0xFFFF && replay_run.buttons == record->buttons && replay_run.mouse_x == record->mouse_x
+       && replay_run.mouse_y == record->mouse_y && replay_run.pointer == record->pointer && replay_run.ticks == record->ticks)
+    {
+        replay_run.repeat++;
+        return;
+    }
+
+    replay_flush_run();
+    replay_run = *record;
+    replay_run.repeat = 1;
+}
+
+void replay_close()
+{
+    if(!replay_file)
+        return;
+
+    if(replay_mode == REPLAY_RECORDING)
+    {
+        if(!replay_polls)
+            replay_write_header();
+        if(replay_has_pending)
+            replay_push(&replay_pending);
+        replay_flush_run();
+        printf("Recorded %u input polls\n", replay_polls);
+    }
+    else if(replay_mode == REPLAY_PLAYING)
+    {
+        printf("Replay finished after %u input polls\n", replay_polls);
+    }
+
+    fclose(replay_file);
+    replay_file = NULL;
+    replay_has_pending = false;
+    replay_mode = REPLAY_OFF;
+}
+
+static void replay_capture(replay_record *record)
+{
+    int x, y;
+
+    memset(record, 0, sizeof(*record));
+    for(int i = 0; i < REPLAY_NUM_BUTTONS; i++)
+    {
+        if(*replay_buttons[i])
+            record->buttons |= BIT(i);
+    }
+
+    record->pointer = ui_get_pointer(&x, &y);
+    record->mouse_x = x;
+    record->mouse_y = y;
+}
+
+static void replay_apply(const replay_record *record)
+{
+    for(int i = 0; i < REPLAY_NUM_BUTTONS; i++)
+        *replay_buttons[i] = (record->buttons & BIT(i)) ? 1 : 0;
+
+    ui_set_pointer(record->mouse_x, record->mouse_y, record->pointer);
+}
+
+//Called at the end of every update_input, records what was polled or replaces it with what was recorded
+void replay_input()
+{
+    if(replay_mode == REPLAY_RECORDING)
+    {
+        if(!replay_polls)
+            replay_write_header();
+
+        if(replay_has_pending)
+            replay_push(&replay_pending);
+
+        replay_capture(&replay_pending);
+        replay_has_pending = true;
+        replay_polls++;
+    }
+    else if(replay_mode == REPLAY_PLAYING)
+    {
+        if(!replay_polls && replay_dat_hash != yodesk_hash)
+            printf("Replay was recorded against a different DAT, it won't play back the same\n");
+
+        if(!replay_left)
+        {
+            if(fread(&replay_current, sizeof(replay_current), 1, replay_file) != 1 || !replay_current.repeat)
+            {
+                replay_close();
+                return;
+            }
+            replay_left = replay_current.repeat;
+        }
+
+        replay_apply(&replay_current);
+        replay_left--;
+        replay_polls++;
+    }
+}
+
+//Called by the main loop after polling, with the ticks it's about to run, and returns the ticks to actually run
+int replay_ticks(int ticks)
+{
+    if(replay_mode == REPLAY_RECORDING && replay_has_pending)
+        replay_pending.ticks = MIN(ticks, 0xFF);
+    else if(replay_mode == REPLAY_PLAYING)
+        return replay_current.ticks;
+
+    return ticks;
+}
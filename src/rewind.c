@@ -0,0 +1,255 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "rewind.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "savestate.h"
+
+/*
+ * Every tick the serialized state is compared against the previous
+ * one and the difference needed to go back is pushed into a fixed ring,
+ * run-length encoded as (u16 zero bytes, u16 literal bytes, literals)
+ * over the XOR of the two states. Stepping back pops the newest record
+ * and applies it to the state we're holding, so the oldest records can
+ * be dropped freely when the ring fills.
+ */
+
+#define REWIND_MIN_ZERO_RUN (4)
+
+u8 *rewind_ring = NULL;
+u32 rewind_head = 0;
+u32 rewind_tail = 0;
+u32 rewind_end = 0;         //Where the last record before a wrap ends
+u32 rewind_count = 0;
+u32 rewind_ticks = 0;
+
+u8 *rewind_state = NULL;    //The newest captured state
+u32 rewind_state_size = 0;
+u32 rewind_state_capacity = 0;
+
+u8 *rewind_scratch = NULL;
+u32 rewind_scratch_capacity = 0;
+
+void rewind_init()
+{
+    rewind_ring = malloc(REWIND_BUFFER_SIZE);
+    rewind_reset();
+}
+
+void rewind_reset()
+{
+    rewind_head = 0;
+    rewind_tail = 0;
+    rewind_end = 0;
+    rewind_count = 0;
+    rewind_ticks = 0;
+    rewind_state_size = 0;
+}
+
+static void rewind_reserve_state(u32 size)
+{
+    if(size <= rewind_state_capacity)
+        return;
+
+    rewind_state = realloc(rewind_state, size);
+    rewind_state_capacity = size;
+}
+
+//XORs target against base (zeros past base_size, or entirely if base is NULL)
+static u32 rewind_encode(const u8 *target, u32 target_size, const u8 *base, u32 base_size, u8 *out)
+{
+    u8 *start = out;
+    u32 i = 0;
+
+#define REWIND_DIFF(n) (base && (n) < base_size ? target[(n)] ^ base[(n)] : target[(n)])
+
+    while(i < target_size)
+    {
+        u32 zeros = 0;
+        while(i < target_size && zeros < 0xFFFF && !REWIND_DIFF(i))
+        {
+            zeros++;
+            i++;
+        }
+
+        //Short gaps of zeros are cheaper to carry along as literals
+        u32 literal_start = i;
+        u32 literals = 0;
+        while(i < target_size && literals < 0xFFFF)
+        {
+            if(!REWIND_DIFF(i))
+            {
+                u32 gap = 0;
+                while(i + gap < target_size && gap < REWIND_MIN_ZERO_RUN && !REWIND_DIFF(i + gap))
+                    gap++;
+
+                if(gap >= REWIND_MIN_ZERO_RUN || i + gap >= target_size)
+                    break;
+            }
+            literals++;
+            i++;
+        }
+
+        //Nothing left to change past here
+        if(!literals && i >= target_size)
+            break;
+
+        u16 header[2] = { zeros, literals };
+        memcpy(out, header, sizeof(header));
+        out += sizeof(header);
+        for(u32 j = literal_start; j < literal_start + literals; j++)
+            *out++ = REWIND_DIFF(j);
+    }
+
+#undef REWIND_DIFF
+
+    return out - start;
+}
+
+static void rewind_decode(const u8 *in, u32 size, u8 *state)
+{
+    const u8 *end = in + size;
+    u32 i = 0;
+
+    while(in < end)
+    {
+        u16 header[2];
+        memcpy(header, in, sizeof(header));
+        in += sizeof(header);
+
+        i += header[0];
+        for(u32 j = 0; j < header[1]; j++)
+            state[i++] ^= *in++;
+    }
+}
+
+static u32 rewind_record_length(u32 payload)
+{
+    return (sizeof(rewind_record) + payload + sizeof(u32) + 3) & ~3;
+}
+
+static void rewind_evict()
+{
+    rewind_record *record = (rewind_record*)(rewind_ring + rewind_tail);
+    rewind_tail += rewind_record_length(record->size);
+    if(rewind_tail == rewind_end && rewind_head < rewind_tail)
+        rewind_tail = 0;
+
+    if(!--rewind_count)
+        rewind_head = rewind_tail = rewind_end = 0;
+}
+
+static void rewind_push(u8 type, u32 state_size, u8 *payload, u32 size)
+{
+    u32 length = rewind_record_length(size);
+    if(length > REWIND_BUFFER_SIZE / 2)
+        return;
+
+    if(rewind_head + length > REWIND_BUFFER_SIZE)
+    {
+        //Everything between the tail and the end of the ring would be overwritten first
+        while(rewind_count && rewind_tail >= rewind_head)
+            rewind_evict();
+
+        rewind_end = rewind_head;
+        rewind_head = 0;
+    }
+
+    while(rewind_count && rewind_tail >= rewind_head && rewind_tail < rewind_head + length)
+        rewind_evict();
+
+    rewind_record *record = (rewind_record*)(rewind_ring + rewind_head);
+    record->size = size;
+    record->state_size = state_size;
+    record->type = type;
+    memcpy(rewind_ring + rewind_head + sizeof(rewind_record), payload, size);
+
+    //Trailer pointing back at the record so the ring can be walked newest first
+    u32 start = rewind_head;
+    rewind_head += length;
+    memcpy(rewind_ring + rewind_head - sizeof(u32), &start, sizeof(u32));
+
+    if(rewind_head > rewind_end)
+        rewind_end = rewind_head;
+    rewind_count++;
+}
+
+void rewind_capture()
+{
+    if(!rewind_ring)
+        return;
+
+    u8 *data;
+    u32 size = savestate_serialize(&data);
+
+    if(rewind_state_size)
+    {
+        //Room for a literal-only encoding of the previous state
+        u32 needed = rewind_state_size + ((rewind_state_size / REWIND_MIN_ZERO_RUN) + 1) * sizeof(u16) * 2;
+        if(needed > rewind_scratch_capacity)
+        {
+            rewind_scratch = realloc(rewind_scratch, needed);
+            rewind_scratch_capacity = needed;
+        }
+
+        bool key = !(rewind_ticks % REWIND_KEY_INTERVAL);
+        u32 encoded = rewind_encode(rewind_state, rewind_state_size, key ? NULL : data, size, rewind_scratch);
+        rewind_push(key ? REWIND_RECORD_KEY : REWIND_RECORD_DELTA, rewind_state_size, rewind_scratch, encoded);
+    }
+
+    rewind_reserve_state(size);
+    memcpy(rewind_state, data, size);
+    rewind_state_size = size;
+    rewind_ticks++;
+}
+
+bool rewind_step()
+{
+    if(!rewind_count)
+        return false;
+
+    if(!rewind_head)
+        rewind_head = rewind_end;
+
+    u32 start;
+    memcpy(&start, rewind_ring + rewind_head - sizeof(u32), sizeof(u32));
+    rewind_record *record = (rewind_record*)(rewind_ring + start);
+
+    rewind_reserve_state(record->state_size);
+    if(record->type == REWIND_RECORD_KEY)
+        memset(rewind_state, 0, record->state_size);
+    else if(record->state_size > rewind_state_size)
+        memset(rewind_state + rewind_state_size, 0, record->state_size - rewind_state_size);
+
+    rewind_decode(rewind_ring + start + sizeof(rewind_record), record->size, rewind_state);
+    rewind_state_size = record->state_size;
+
+    rewind_head = start;
+    if(rewind_tail < rewind_head)
+        rewind_end = rewind_head;
+    if(!--rewind_count)
+        rewind_head = rewind_tail = rewind_end = 0;
+    if(rewind_ticks)
+        rewind_ticks--;
+
+    return savestate_apply(rewind_state, rewind_state_size);
+}
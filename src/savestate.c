@@ -0,0 +1,540 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "savestate.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "map.h"
+#include "zone.h"
+#include "assets.h"
+#include "player.h"
+#include "palette.h"
+
+#if defined(PC_BUILD) && !defined(_WIN32)
+#define SAVESTATE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef PC_BUILD
+#define log(f_, ...) printf((f_), __VA_ARGS__)
+#elif WIIU
+    #include <coreinit/debug.h>
+    #define log(f_, ...) OSReport((f_), __VA_ARGS__)
+#endif
+
+#define SAVESTATE_ALIGN(x) (((x) + 3) & ~3)
+
+extern entity *entities[512];
+extern u16 num_entities;
+extern u16 *map_overlay;
+extern u16 *map_global_vars;
+extern u16 *map_temp_vars;
+extern u16 *map_rand_vars;
+extern u16 DOOR_IN_x;
+extern u16 DOOR_IN_y;
+extern u16 DOOR_IN_map;
+
+//Reused between saves so serializing every frame doesn't touch the allocator
+u8 *savestate_buffer = NULL;
+u32 savestate_capacity = 0;
+u32 savestate_size = 0;
+
+//The state zones were last loaded from, they may still point into it
+u8 *savestate_loaded = NULL;
+u32 savestate_loaded_size = 0;
+bool savestate_loaded_mapped = false;
+
+static void *savestate_reserve(u32 size)
+{
+    u32 offset = savestate_size;
+    savestate_size += SAVESTATE_ALIGN(size);
+
+    if(savestate_size > savestate_capacity)
+    {
+        while(savestate_size > savestate_capacity)
+            savestate_capacity = savestate_capacity ? savestate_capacity * 2 : 0x10000;
+        savestate_buffer = realloc(savestate_buffer, savestate_capacity);
+    }
+
+    return savestate_buffer + offset;
+}
+
+static void savestate_write(void *data, u32 size)
+{
+    if(!size)
+        return;
+
+    memcpy(savestate_reserve(size), data, size);
+}
+
+u32 savestate_serialize(u8 **out)
+{
+    u16 map_id = map_get_id();
+    savestate_size = 0;
+
+    map_sync_zone();
+
+    savestate_header *header = savestate_reserve(sizeof(savestate_header));
+    header->magic = SAVESTATE_MAGIC;
+    header->version = SAVESTATE_VERSION;
+    header->num_zones = NUM_MAPS;
+    header->dat_hash = yodesk_hash;
+
+    savestate_globals *globals = savestate_reserve(sizeof(savestate_globals));
+    globals->player = player_entity;
+    globals->map_id = map_id;
+    globals->experience = player_experience;
+    globals->equipped_item = PLAYER_EQUIPPED_ITEM;
+    globals->inventory_count = player_inventory_count;
+    globals->map_change_to = PLAYER_MAP_CHANGE_TO;
+    globals->map_change_reason = PLAYER_MAP_CHANGE_REASON;
+    globals->camera_locked = map_camera_locked;
+    globals->camera_x = map_camera_x;
+    globals->camera_y = map_camera_y;
+    globals->door_in_x = DOOR_IN_x;
+    globals->door_in_y = DOOR_IN_y;
+    globals->door_in_map = DOOR_IN_map;
+    globals->global_var = map_global_vars[0];
+    globals->map_width = map_get_width();
+    globals->map_height = map_get_height();
+    globals->num_entities = num_entities;
+    globals->num_zone_records = 0;
+    memcpy(globals->palette, yodesk_palette, sizeof(yodesk_palette));
+
+    savestate_write(player_inventory, player_inventory_count * sizeof(u16));
+    for(int i = 0; i < num_entities; i++)
+        savestate_write(entities[i], sizeof(entity));
+    savestate_write(map_overlay, map_get_width() * map_get_height() * sizeof(u16));
+    savestate_write(map_temp_vars, NUM_MAPS * sizeof(u16));
+    savestate_write(map_rand_vars, NUM_MAPS * sizeof(u16));
+
+    u16 num_zone_records = 0;
+    for(int i = 0; i < NUM_MAPS; i++)
+    {
+        zone_state *zone = zone_get(i);
+        if(!zone->visited)
+            continue;
+
+        savestate_zone *record = savestate_reserve(sizeof(savestate_zone));
+        record->zone_id = i;
+        record->width = zone->width;
+        record->height = zone->height;
+        record->num_objects = zone->num_objects;
+        record->tiles_offset = zone->tiles_offset;
+        record->objects_offset = zone->objects_offset;
+        record->delta_count = zone->delta_count;
+        record->has_dense = zone->dense != NULL;
+
+        savestate_write(zone->delta, zone->delta_count * sizeof(zone_delta));
+        if(zone->dense)
+            savestate_write(zone->dense, zone->width * zone->height * ZONE_NUM_PLANES * sizeof(u16));
+
+        num_zone_records++;
+    }
+
+    //The buffer may have moved while growing
+    header = (savestate_header*)savestate_buffer;
+    globals = (savestate_globals*)(savestate_buffer + SAVESTATE_ALIGN(sizeof(savestate_header)));
+    header->size = savestate_size;
+    globals->num_zone_records = num_zone_records;
+
+    *out = savestate_buffer;
+    return savestate_size;
+}
+
+static void savestate_release_loaded()
+{
+    if(!savestate_loaded)
+        return;
+
+#ifdef SAVESTATE_MMAP
+    if(savestate_loaded_mapped)
+        munmap(savestate_loaded, savestate_loaded_size);
+    else
+#endif
+        free(savestate_loaded);
+
+    savestate_loaded = NULL;
+    savestate_loaded_size = 0;
+    savestate_loaded_mapped = false;
+}
+
+//Where map_read_zone finds a zone's size and tiles, returns the location of the tiles
+static u32 savestate_zone_size(u16 zone_id, u16 *width, u16 *height)
+{
+    u32 location = zone_data[zone_id]->izon_offset + 4 + 4; //IZON, length
+    *width = peek_short(location);
+    *height = peek_short(location + 2);
+
+    return location + 2 + 2 + 1 + 5 + 1 + 1;
+}
+
+//A zone record has to describe the same zone the DAT does, lookups index the DAT planes with its size
+static bool savestate_zone_matches(const savestate_zone *record)
+{
+    u16 width, height;
+    u32 tiles = savestate_zone_size(record->zone_id, &width, &height);
+    if(record->width != width || record->height != height || record->tiles_offset != tiles)
+        return false;
+
+    u32 objects;
+    if(!is_yoda)
+    {
+        if(!zone_data[record->zone_id]->htsp_offset)
+            return record->num_objects == 0;
+        objects = zone_data[record->zone_id]->htsp_offset;
+    }
+    else
+    {
+        objects = tiles + (width * height * sizeof(u16) * ZONE_NUM_PLANES);
+    }
+
+    return record->objects_offset == objects + sizeof(u16) && record->num_objects == peek_short(objects);
+}
+
+//Delta keys index the dense planes and the object table directly, and lookups bisect them
+static bool savestate_deltas_valid(const savestate_zone *record, const zone_delta *delta)
+{
+    for(u32 i = 0; i < record->delta_count; i++)
+    {
+        u32 kind = ZONE_DELTA_KIND_OF(delta[i].key);
+        u32 index = ZONE_DELTA_INDEX_OF(delta[i].key);
+
+        if(i && delta[i].key <= delta[i-1].key)
+            return false;
+
+        if(kind < ZONE_NUM_PLANES)
+        {
+            if(index >= (u32)(record->width * record->height))
+                return false;
+        }
+        else if(kind == ZONE_DELTA_OBJECT_VISIBLE || kind == ZONE_DELTA_OBJECT_ARG)
+        {
+            if(index >= record->num_objects)
+                return false;
+        }
+        else if(kind != ZONE_DELTA_FLAGONCE)
+            return false;
+    }
+
+    return true;
+}
+
+//Entities index the character table with their id and the zone's tiles with their position
+static bool savestate_entity_valid(const entity *e, u16 width, u16 height)
+{
+    return e->char_id < char_count && char_data[e->char_id]
+           && e->x < width && e->y < height && e->current_frame < 26;
+}
+
+//Every count, offset and index in the file is checked here, before fixup lets any of it touch the game state
+static bool savestate_validate(u8 *data, u32 size)
+{
+    savestate_header *header = (savestate_header*)data;
+    if(size < SAVESTATE_ALIGN(sizeof(savestate_header)) + SAVESTATE_ALIGN(sizeof(savestate_globals)))
+        return false;
+
+    if(header->magic != SAVESTATE_MAGIC || header->version != SAVESTATE_VERSION)
+    {
+        log("Save state is not a version %u save\n", SAVESTATE_VERSION);
+        return false;
+    }
+
+    if(header->dat_hash != yodesk_hash || header->num_zones != NUM_MAPS || header->size != size)
+    {
+        log("Save state was made against a different DAT (%08x, ours is %08x)\n", header->dat_hash, yodesk_hash);
+        return false;
+    }
+
+    u8 *cursor = data + SAVESTATE_ALIGN(sizeof(savestate_header));
+    u8 *end = data + size;
+    savestate_globals *globals = (savestate_globals*)cursor;
+    cursor += SAVESTATE_ALIGN(sizeof(savestate_globals));
+
+    u16 width, height;
+    if(globals->map_id >= NUM_MAPS || globals->inventory_count > 0x100 || globals->num_entities > 512
+       || (globals->equipped_item != 0xFFFF && globals->equipped_item >= globals->inventory_count))
+    {
+        log("Save state for zone %u is damaged\n", globals->map_id);
+        return false;
+    }
+
+    savestate_zone_size(globals->map_id, &width, &height);
+    if(globals->map_width != width || globals->map_height != height)
+    {
+        log("Save state's zone %u is %ux%u, the DAT's is %ux%u\n", globals->map_id, globals->map_width, globals->map_height, width, height);
+        return false;
+    }
+
+    u32 fixed = SAVESTATE_ALIGN(globals->inventory_count * sizeof(u16)) + (globals->num_entities * SAVESTATE_ALIGN(sizeof(entity)))
+                + SAVESTATE_ALIGN(width * height * sizeof(u16)) + (2 * SAVESTATE_ALIGN(NUM_MAPS * sizeof(u16)));
+    if(fixed > (u32)(end - cursor))
+    {
+        log("Save state is truncated at %u bytes\n", size);
+        return false;
+    }
+
+    u8 *saved_entities = cursor + SAVESTATE_ALIGN(globals->inventory_count * sizeof(u16));
+    bool entities_valid = savestate_entity_valid(&globals->player, width, height) && globals->player.extend_frame < 26;
+    for(int i = 0; i < globals->num_entities && entities_valid; i++)
+        entities_valid = savestate_entity_valid((entity*)(saved_entities + (i * SAVESTATE_ALIGN(sizeof(entity)))), width, height);
+
+    if(!entities_valid)
+    {
+        log("Save state has an entity outside of zone %u or the DAT's characters\n", globals->map_id);
+        return false;
+    }
+    cursor += fixed;
+
+    for(int i = 0; i < globals->num_zone_records; i++)
+    {
+        savestate_zone *record = (savestate_zone*)cursor;
+        if(SAVESTATE_ALIGN(sizeof(savestate_zone)) > (u32)(end - cursor))
+            return false;
+        cursor += SAVESTATE_ALIGN(sizeof(savestate_zone));
+
+        if(record->zone_id >= NUM_MAPS || !savestate_zone_matches(record))
+        {
+            log("Save state's zone record %u doesn't match the DAT\n", i);
+            return false;
+        }
+
+        if(record->delta_count > (u32)(end - cursor) / sizeof(zone_delta))
+            return false;
+        if(!savestate_deltas_valid(record, (zone_delta*)cursor))
+        {
+            log("Save state's zone record %u has a bad change list\n", i);
+            return false;
+        }
+        cursor += SAVESTATE_ALIGN(record->delta_count * sizeof(zone_delta));
+
+        if(record->has_dense)
+        {
+            u32 dense = SAVESTATE_ALIGN(record->width * record->height * ZONE_NUM_PLANES * sizeof(u16));
+            if(cursor > end || dense > (u32)(end - cursor))
+                return false;
+            cursor += dense;
+        }
+    }
+
+    return cursor <= end;
+}
+
+//Points everything at the data in the save state, which must stay alive
+//until the next load
+static void savestate_fixup(u8 *data)
+{
+    u8 *cursor = data + SAVESTATE_ALIGN(sizeof(savestate_header));
+    savestate_globals *globals = (savestate_globals*)cursor;
+    cursor += SAVESTATE_ALIGN(sizeof(savestate_globals));
+
+    u16 *inventory = (u16*)cursor;
+    cursor += SAVESTATE_ALIGN(globals->inventory_count * sizeof(u16));
+    entity *saved_entities = (entity*)cursor;
+    cursor += globals->num_entities * SAVESTATE_ALIGN(sizeof(entity));
+    u16 *overlay = (u16*)cursor;
+    cursor += SAVESTATE_ALIGN(globals->map_width * globals->map_height * sizeof(u16));
+    u16 *temp_vars = (u16*)cursor;
+    cursor += SAVESTATE_ALIGN(NUM_MAPS * sizeof(u16));
+    u16 *rand_vars = (u16*)cursor;
+    cursor += SAVESTATE_ALIGN(NUM_MAPS * sizeof(u16));
+
+    for(int i = 0; i < NUM_MAPS; i++)
+        zone_reset(zone_get(i));
+
+    for(int i = 0; i < globals->num_zone_records; i++)
+    {
+        savestate_zone *record = (savestate_zone*)cursor;
+        cursor += SAVESTATE_ALIGN(sizeof(savestate_zone));
+
+        zone_state *zone = zone_get(record->zone_id);
+        zone->width = record->width;
+        zone->height = record->height;
+        zone->num_objects = record->num_objects;
+        zone->tiles_offset = record->tiles_offset;
+        zone->objects_offset = record->objects_offset;
+        zone->visited = true;
+
+        if(record->delta_count)
+        {
+            zone->delta = (zone_delta*)cursor;
+            zone->delta_count = record->delta_count;
+            zone->delta_capacity = record->delta_count;
+            zone->borrowed |= ZONE_BORROWED_DELTA;
+            cursor += SAVESTATE_ALIGN(record->delta_count * sizeof(zone_delta));
+        }
+
+        if(record->has_dense)
+        {
+            zone->dense = (u16*)cursor;
+            zone->borrowed |= ZONE_BORROWED_DENSE;
+            cursor += SAVESTATE_ALIGN(zone->width * zone->height * ZONE_NUM_PLANES * sizeof(u16));
+        }
+    }
+
+    //Zones are in place, now bring the current one back up
+    map_restore(globals->map_id);
+    memcpy(map_overlay, overlay, globals->map_width * globals->map_height * sizeof(u16));
+    memcpy(map_temp_vars, temp_vars, NUM_MAPS * sizeof(u16));
+    memcpy(map_rand_vars, rand_vars, NUM_MAPS * sizeof(u16));
+    map_global_vars[0] = globals->global_var;
+
+    //map_restore doesn't spawn anything, but whatever is there can't be leaked or kept
+    for(int i = 0; i < num_entities; i++)
+        free(entities[i]);
+
+    for(int i = 0; i < globals->num_entities; i++)
+    {
+        entities[i] = malloc(sizeof(entity));
+        memcpy(entities[i], &saved_entities[i], sizeof(entity));
+    }
+    num_entities = globals->num_entities;
+
+    player_entity = globals->player;
+    player_experience = globals->experience;
+    PLAYER_EQUIPPED_ITEM = globals->equipped_item;
+    player_inventory_count = globals->inventory_count;
+    memcpy(player_inventory, inventory, globals->inventory_count * sizeof(u16));
+    PLAYER_MAP_CHANGE_TO = globals->map_change_to;
+    PLAYER_MAP_CHANGE_REASON = globals->map_change_reason;
+    DOOR_IN_x = globals->door_in_x;
+    DOOR_IN_y = globals->door_in_y;
+    DOOR_IN_map = globals->door_in_map;
+
+    map_camera_locked = globals->camera_locked;
+    map_camera_x = globals->camera_x;
+    map_camera_y = globals->camera_y;
+    memcpy(yodesk_palette, globals->palette, sizeof(yodesk_palette));
+
+    render_map();
+}
+
+//Applies a state held in memory, the data is copied so the caller keeps ownership
+bool savestate_apply(u8 *data, u32 size)
+{
+    if(!savestate_validate(data, size))
+        return false;
+
+    //Zones can't be left pointing into the old state while it's replaced
+    for(int i = 0; i < NUM_MAPS; i++)
+        zone_reset(zone_get(i));
+    savestate_release_loaded();
+
+    savestate_loaded = malloc(size);
+    savestate_loaded_size = size;
+    memcpy(savestate_loaded, data, size);
+
+    savestate_fixup(savestate_loaded);
+    return true;
+}
+
+bool savestate_save(const char *path)
+{
+    u8 *data;
+    u32 size = savestate_serialize(&data);
+
+    FILE *file = fopen(path, "wb");
+    if(!file)
+    {
+        log("Failed to open '%s' for saving!\n", path);
+        return false;
+    }
+
+    bool written = fwrite(data, size, 1, file) == 1;
+    fclose(file);
+
+    log("Saved %u bytes to '%s'\n", size, path);
+    return written;
+}
+
+bool savestate_load(const char *path)
+{
+    u8 *data = NULL;
+    u32 size = 0;
+    bool mapped = false;
+
+#ifdef SAVESTATE_MMAP
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        log("Failed to open '%s' for loading!\n", path);
+        return false;
+    }
+
+    struct stat st;
+    if(!fstat(fd, &st) && st.st_size > 0)
+    {
+        size = st.st_size;
+        data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED)
+            data = NULL;
+        else
+            mapped = true;
+    }
+    close(fd);
+#else
+    FILE *file = fopen(path, "rb");
+    if(!file)
+    {
+        log("Failed to open '%s' for loading!\n", path);
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    rewind(file);
+
+    data = malloc(size);
+    if(fread(data, size, 1, file) != 1)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+#endif
+
+    if(!data || !savestate_validate(data, size))
+    {
+#ifdef SAVESTATE_MMAP
+        if(mapped)
+            munmap(data, size);
+#endif
+        if(!mapped)
+            free(data);
+        return false;
+    }
+
+    for(int i = 0; i < NUM_MAPS; i++)
+        zone_reset(zone_get(i));
+    savestate_release_loaded();
+
+    savestate_loaded = data;
+    savestate_loaded_size = size;
+    savestate_loaded_mapped = mapped;
+
+    savestate_fixup(savestate_loaded);
+    log("Loaded '%s'\n", path);
+    return true;
+}
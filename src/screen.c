@@ -20,28 +20,51 @@
 
 #include "screen.h"
 
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "main.h"
 #include "useful.h"
 #include "player.h"
 #include "map.h"
+#include "tile.h"
+#include "ui.h"
+#include "assets.h"
+#include "frame.h"
+#include "profile.h"
+#include "render_gl.h"
 
 void render(int x, int y);
 void render_pre();
 void render_post();
 void render_flip_buffers();
 
-unsigned short tiles_low[0x100 * 0x100];
-unsigned short tiles_middle[0x100 * 0x100];
-unsigned short tiles_middle_overlay[0x100 * 0x100];
-unsigned short tiles_high[0x100 * 0x100];
-unsigned short tiles_overlay[0x100 * 0x100];
+//All five layers and the dirty flags share one allocation
+void *screen_layers = NULL;
+u32 screen_layer_cells = 0;
+
+unsigned short *tiles_low;
+unsigned short *tiles_middle;
+unsigned short *tiles_middle_overlay;
+unsigned short *tiles_high;
+unsigned short *tiles_overlay;
+
+u8 *screen_dirty_flags;
+u16 screen_dirty_cells[SCREEN_MAX_DIRTY];
+u16 screen_dirty_count = 0;
+bool screen_dirty_all = true;
+bool screen_rebuild = true; //Tells render_map the layers can't be patched and need rebuilding
 
 char *active_text;
 int active_text_x;
 int active_text_y;
 
+//Render side of change detection, the frames carry whether game state changed
+bool screen_present_pending = true;
+u32 screen_skipped_frames = 0;
+u32 screen_presented_ui_key = 0;
+
 u32 SCREEN_WIDTH = 288;
 u32 SCREEN_HEIGHT = 288;
 
@@ -52,27 +75,176 @@ u8 SCREEN_FADE_LEVEL = 0;
 //Default game uses 10fps for "Normal" speed, +- 5fps for Slow/Fast
 u16 TARGET_TICK_FPS = 10;
 
+static void screen_alloc_layers()
+{
+    u32 cells = SCREEN_TILE_WIDTH * SCREEN_TILE_HEIGHT;
+    if(screen_layers && cells == screen_layer_cells)
+        return;
+
+    free(screen_layers);
+    screen_layers = malloc(cells * ((sizeof(unsigned short) * 5) + sizeof(u8)));
+    screen_layer_cells = cells;
+
+    tiles_low = (unsigned short*)screen_layers;
+    tiles_middle = tiles_low + cells;
+    tiles_middle_overlay = tiles_middle + cells;
+    tiles_high = tiles_middle_overlay + cells;
+    tiles_overlay = tiles_high + cells;
+    screen_dirty_flags = (u8*)(tiles_overlay + cells);
+
+    memset(tiles_low, 0xFF, cells * sizeof(unsigned short) * 5);
+    memset(screen_dirty_flags, 0, cells);
+    screen_dirty_count = 0;
+}
+
 void init_screen()
 {
-    for(int i = 0; i < 0x100 * 0x100; i++)
+    screen_alloc_layers();
+
+    u32 cells = SCREEN_TILE_WIDTH * SCREEN_TILE_HEIGHT;
+    for(int i = 0; i < cells; i++)
     {
         tiles_low[i] = 0xFFFF;
         tiles_middle[i] = 0xFFFF;
         tiles_high[i] = 0xFFFF;
     }
+
+    screen_mark_all_dirty();
 }
 
-int draw_screen()
+void screen_mark_dirty(u32 index)
 {
-    SCREEN_FADE_LEVEL = MIN(SCREEN_FADE_LEVEL, (SCREEN_TILE_WIDTH/2)+1);
+    if(screen_dirty_all || screen_dirty_flags[index])
+        return;
+
+    if(screen_dirty_count >= SCREEN_MAX_DIRTY)
+    {
+        screen_dirty_all = true;
+        return;
+    }
+
+    screen_dirty_flags[index] = 1;
+    screen_dirty_cells[screen_dirty_count++] = index;
+}
+
+static bool screen_tile_animated(u16 tile, u8 mask)
+{
+    return tile < 0x2000 && (tile_palette_anim[tile] & mask);
+}
+
+//Marks cells showing any tile that uses the given PALETTE_ANIM_* groups
+void screen_mark_palette_dirty(u8 mask)
+{
+#ifdef RENDER_GL
+    render_gl_mark_palette(mask);
+#endif
+
+    if(mask && ui_uses_palette(mask))
+        frame_mark_changed();
+
+    if(!mask || screen_dirty_all)
+        return;
+
+    for(int i = 0; i < SCREEN_TILE_WIDTH*SCREEN_TILE_HEIGHT; i++)
+    {
+        if(screen_tile_animated(tiles_low[i], mask) || screen_tile_animated(tiles_middle[i], mask) || screen_tile_animated(tiles_middle_overlay[i], mask)
+           || screen_tile_animated(tiles_high[i], mask) || screen_tile_animated(tiles_overlay[i], mask))
+            screen_mark_dirty(i);
+    }
+}
+
+void screen_mark_all_dirty()
+{
+    screen_dirty_all = true;
+    screen_rebuild = true;
+}
 
+void screen_clear_dirty()
+{
+    for(int i = 0; i < screen_dirty_count; i++)
+        screen_dirty_flags[screen_dirty_cells[i]] = 0;
+
+    screen_dirty_count = 0;
+    screen_dirty_all = false;
+}
+
+//For changes on the render side the frames can't see, like a new upscale filter
+void screen_request_present()
+{
+    screen_present_pending = true;
+}
+
+//Draws the newest published frame, returns 0 when skipped because it would have looked the same
+int screen_present()
+{
+    bool fresh;
+    const screen_frame *frame = frame_acquire(&fresh);
+    if(!frame->sequence || frame->cells != SCREEN_TILE_WIDTH * SCREEN_TILE_HEIGHT)
+        return 0;
+
+    u32 ui_key = ui_frame_key();
+    //The overlay is redrawn every frame so it keeps up with the timings
+    bool changed = (fresh && frame->changed) || screen_present_pending || ui_key != screen_presented_ui_key || PROFILE_OVERLAY_VISIBLE();
+    screen_presented_ui_key = ui_key;
+
+    if(!changed && ++screen_skipped_frames < SCREEN_HEARTBEAT_FRAMES)
+        return 0;
+
+    screen_skipped_frames = 0;
+    screen_present_pending = false;
+
+    frame_current = frame;
+    PROFILE_BEGIN(PROFILE_RENDER);
     render_pre();
     render(0, 0);
+    PROFILE_END(PROFILE_RENDER);
+
+    PROFILE_BEGIN(PROFILE_UI_RENDER);
     render_post();
+    PROFILE_END(PROFILE_UI_RENDER);
+    PROFILE_DRAW_OVERLAY();
+
+    PROFILE_BEGIN(PROFILE_FLIP);
     render_flip_buffers();
+    PROFILE_END(PROFILE_FLIP);
+    frame_current = NULL;
     return 1;
 }
 
+//Hands the game state to the renderer as a frame, callers hold the world lock
+void screen_publish()
+{
+    SCREEN_FADE_LEVEL = MIN(SCREEN_FADE_LEVEL, (SCREEN_TILE_WIDTH/2)+1);
+
+    frame_publish();
+    screen_clear_dirty();
+}
+
+//Publishes the game state as a frame, and draws it too unless a render thread does that
+int draw_screen()
+{
+    screen_publish();
+
+    if(frame_threaded && !frame_on_render_thread())
+        return 1;
+
+    return screen_present();
+}
+
+//Waits inside a blocking game loop, letting the render thread in at the world state meanwhile
+void screen_sleep(u32 usec)
+{
+    if(frame_threaded && !frame_on_render_thread())
+    {
+        frame_unlock_world();
+        usleep(usec);
+        frame_lock_world();
+        return;
+    }
+
+    usleep(usec);
+}
+
 void screen_transition_out()
 {
     for(int i = (SCREEN_TILE_WIDTH > map_get_width() ? ((SCREEN_TILE_WIDTH-map_get_width())/2)+1 : 0); i <= (SCREEN_TILE_WIDTH/2)+1; i++)
@@ -81,7 +253,7 @@ void screen_transition_out()
 
         SCREEN_FADE_LEVEL = i;
         draw_screen();
-        usleep(1000*(1000/TARGET_TICK_FPS));
+        screen_sleep(1000*(1000/TARGET_TICK_FPS));
     }
 }
 
@@ -93,7 +265,7 @@ void screen_transition_in()
 
         SCREEN_FADE_LEVEL = i;
         draw_screen();
-        usleep(1000*(1000/TARGET_TICK_FPS));
+        screen_sleep(1000*(1000/TARGET_TICK_FPS));
     }
     SCREEN_FADE_LEVEL = 0;
     draw_screen();
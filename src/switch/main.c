@@ -31,6 +31,7 @@
 #include "tname.h"
 #include "map.h"
 #include "ui.h"
+#include "framebuffer.h"
 
 bool initialized = false;
 bool isAppRunning = true;
@@ -44,6 +45,7 @@ main(int argc, char **argv)
     gfxInitDefault();
     
     ui_init(0,0,1280,720, false);
+    framebuffer_init(1280, 720);
     ui_set_draw_scale(2);
     ui_update();
     load_resources();
@@ -180,6 +182,20 @@ void update_input()
 
 void render_flip_buffers()
 {
+    u32 width, height;
+    u32 *out = (u32*)gfxGetFramebuffer(&width, &height);
+
+    //The framebuffer is ARGB, the display wants ABGR
+    width = MIN(width, framebuffer_width);
+    height = MIN(height, framebuffer_height);
+    for(u32 y = 0; y < height; y++)
+    {
+        u32 *in = framebuffer + (y * framebuffer_pitch);
+        u32 *row = out + (y * width);
+        for(u32 x = 0; x < width; x++)
+            row[x] = (in[x] & 0xFF00FF00) | ((in[x] >> 16) & 0xFF) | ((in[x] & 0xFF) << 16);
+    }
+
     gfxFlushBuffers();
     gfxSwapBuffers();
 }
@@ -0,0 +1,184 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "text.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "font.h"
+
+typedef struct text_font
+{
+    const FONT_INFO *info;
+    const FONT_CHAR_INFO *descriptors;
+    const u8 *bitmaps;
+    int height;
+
+    //Each glyph rasterized into a TEXT_GLYPH_WIDTH x height cell, one byte per pixel
+    u8 atlas[TEXT_NUM_GLYPHS * TEXT_GLYPH_WIDTH * DESKADV_INV_FONT_HEIGHT];
+} text_font;
+
+text_font text_fonts[TEXT_NUM_FONTS];
+bool text_initialized = false;
+
+text_layout text_cache[TEXT_CACHE_SIZE];
+u32 text_cache_next = 0;
+
+void text_init()
+{
+    if(text_initialized)
+        return;
+
+    text_fonts[TEXT_FONT_DIALOG].info = &deskAdvFontFontInfo;
+    text_fonts[TEXT_FONT_DIALOG].descriptors = deskAdvFontDescriptors;
+    text_fonts[TEXT_FONT_DIALOG].bitmaps = deskAdvFontBitmaps;
+    text_fonts[TEXT_FONT_DIALOG].height = DESKADV_FONT_FONT_HEIGHT;
+
+    text_fonts[TEXT_FONT_INVENTORY].info = &deskAdvInvFontInfo;
+    text_fonts[TEXT_FONT_INVENTORY].descriptors = deskAdvInvFontDescriptors;
+    text_fonts[TEXT_FONT_INVENTORY].bitmaps = deskAdvInvFontBitmaps;
+    text_fonts[TEXT_FONT_INVENTORY].height = DESKADV_INV_FONT_HEIGHT;
+
+    for(int f = 0; f < TEXT_NUM_FONTS; f++)
+    {
+        text_font *font = &text_fonts[f];
+        memset(font->atlas, 0, sizeof(font->atlas));
+
+        for(int c = 0; c < TEXT_NUM_GLYPHS; c++)
+        {
+            u8 *cell = font->atlas + (c * TEXT_GLYPH_WIDTH * font->height);
+            int offset = font->descriptors[c].offset;
+            for(int i = 0; i < font->descriptors[c].width; i++)
+            {
+                for(int j = 0; j < font->height; j++)
+                {
+                    if(font->bitmaps[offset+j] & (1<<(7-i)))
+                        cell[(j * TEXT_GLYPH_WIDTH) + i] = 1;
+                }
+            }
+        }
+    }
+
+    text_initialized = true;
+}
+
+static u32 text_hash(const char *text)
+{
+    u32 hash = 0x811C9DC5;
+    for(; *text; text++)
+        hash = (hash ^ (u8)*text) * 0x01000193;
+
+    return hash;
+}
+
+//Glyph index for a character, -1 for spaces and anything the font doesn't have
+static int text_glyph(const text_font *font, char c)
+{
+    if(c < font->info->start_char || c - font->info->start_char >= TEXT_NUM_GLYPHS)
+        return -1;
+
+    return c - font->info->start_char;
+}
+
+static int text_advance(const text_font *font, char c)
+{
+    int glyph = text_glyph(font, c);
+    if(c == ' ' || glyph < 0)
+        return font->info->space_width+1;
+
+    return font->descriptors[glyph].width+1;
+}
+
+/*
+ * Same wrapping as the original strip: a new line starts once the pen has
+ * gone past wrap, checked before each character. wrap 0 never wraps.
+ */
+static void text_layout_build(text_layout *layout)
+{
+    const text_font *font = &text_fonts[layout->font];
+    int x = 0, lines = 1, width = 0;
+
+    for(const char *c = layout->text; *c; c++)
+    {
+        if(layout->wrap && x > layout->wrap)
+        {
+            x = 0;
+            lines++;
+        }
+        x += text_advance(font, *c);
+        width = MAX(width, x);
+    }
+
+    layout->num_lines = lines;
+    layout->width = MAX(width, 1);
+    layout->height = ((lines - 1) * TEXT_LINE_ADVANCE) + font->height;
+    layout->mask = calloc(layout->width * layout->height, sizeof(u8));
+
+    x = 0;
+    int y = 0;
+    for(const char *c = layout->text; *c; c++)
+    {
+        if(layout->wrap && x > layout->wrap)
+        {
+            x = 0;
+            y += TEXT_LINE_ADVANCE;
+        }
+
+        int glyph = text_glyph(font, *c);
+        if(*c != ' ' && glyph >= 0)
+        {
+            const u8 *cell = font->atlas + (glyph * TEXT_GLYPH_WIDTH * font->height);
+            for(int j = 0; j < font->height; j++)
+                memcpy(layout->mask + ((y + j) * layout->width) + x, cell + (j * TEXT_GLYPH_WIDTH), font->descriptors[glyph].width);
+        }
+        x += text_advance(font, *c);
+    }
+}
+
+//Finds or builds the layout of a string, the result is valid until TEXT_CACHE_SIZE other strings are laid out
+text_layout *text_layout_get(u8 font, const char *text, u16 wrap)
+{
+    text_init();
+
+    u32 hash = text_hash(text);
+    for(int i = 0; i < TEXT_CACHE_SIZE; i++)
+    {
+        text_layout *layout = &text_cache[i];
+        if(layout->text && layout->hash == hash && layout->font == font && layout->wrap == wrap && !strcmp(layout->text, text))
+            return layout;
+    }
+
+    text_layout *layout = &text_cache[text_cache_next];
+    text_cache_next = (text_cache_next + 1) % TEXT_CACHE_SIZE;
+
+    free(layout->text);
+    free(layout->mask);
+
+    size_t length = strlen(text);
+    layout->text = malloc(length + 1);
+    memcpy(layout->text, text, length + 1);
+    layout->font = font;
+    layout->wrap = wrap;
+    layout->hash = hash;
+    text_layout_build(layout);
+
+    return layout;
+}
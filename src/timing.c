@@ -0,0 +1,129 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "timing.h"
+
+#include <time.h>
+#include "screen.h"
+
+#ifdef PC_BUILD
+#include <SDL2/SDL.h>
+#endif
+
+/*
+ * Fixed timestep scheduling: wall time accumulates and is paid out in
+ * whole ticks of 1000/TARGET_TICK_FPS ms, so game speed doesn't depend
+ * on how often frames are drawn. Frames are capped to TIMING_RENDER_FPS,
+ * either by a vsynced present or by sleeping out the rest of the frame.
+ * Ticks and frames keep separate clocks, so they can run on separate threads.
+ */
+
+bool timing_vsync = false;
+u32 timing_ticks_dropped = 0;
+
+double timing_accumulator = 0.0;
+double timing_tick_start = 0.0;
+double timing_frame_start = 0.0;
+
+//Milliseconds on a monotonic clock
+double timing_now_ms()
+{
+#ifdef PC_BUILD
+    static double ms_per_count = 0.0;
+    if(!ms_per_count)
+        ms_per_count = 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+    return (double)SDL_GetPerformanceCounter() * ms_per_count;
+#else
+    return (double)clock() / (CLOCKS_PER_SEC / 1000.0);
+#endif
+}
+
+//Platforms without a way to sleep rely on vsync to pace the loop
+void timing_sleep_ms(double ms)
+{
+#ifdef PC_BUILD
+    if(ms >= 1.0)
+        SDL_Delay((Uint32)ms);
+#endif
+}
+
+void timing_init()
+{
+    timing_accumulator = 0.0;
+    timing_ticks_dropped = 0;
+    timing_tick_start = timing_now_ms();
+    timing_frame_start = timing_tick_start;
+}
+
+static double timing_tick_ms()
+{
+    return 1000.0 / (double)(TARGET_TICK_FPS ? TARGET_TICK_FPS : 1);
+}
+
+//Number of game ticks due since the last call
+int timing_ticks_due()
+{
+    double tick_ms = timing_tick_ms();
+    double now = timing_now_ms();
+
+    timing_accumulator += now - timing_tick_start;
+    timing_tick_start = now;
+
+    int ticks = (int)(timing_accumulator / tick_ms);
+    timing_accumulator -= ticks * tick_ms;
+
+    //After a stall (a long load, a dragged window) skip ahead instead of fast-forwarding
+    if(ticks > TIMING_MAX_TICKS_PER_FRAME)
+    {
+        timing_ticks_dropped += ticks - TIMING_MAX_TICKS_PER_FRAME;
+        ticks = TIMING_MAX_TICKS_PER_FRAME;
+    }
+
+    return ticks;
+}
+
+//For a simulation thread with nothing to draw, sleeps until the next tick is due
+void timing_sleep_until_tick()
+{
+    timing_sleep_ms(timing_tick_ms() - timing_accumulator - (timing_now_ms() - timing_tick_start));
+}
+
+//Starts a frame that only draws, ticks are run elsewhere
+void timing_render_begin()
+{
+    timing_frame_start = timing_now_ms();
+}
+
+//Starts a frame and returns the number of game ticks due in it
+int timing_frame_begin()
+{
+    timing_render_begin();
+    return timing_ticks_due();
+}
+
+//Sleeps out whatever is left of this frame's slot, a skipped frame has no vsync wait to lean on
+void timing_frame_end(bool presented)
+{
+    if(timing_vsync && presented)
+        return;
+
+    timing_sleep_ms(timing_frame_start + (1000.0 / TIMING_RENDER_FPS) - timing_now_ms());
+}
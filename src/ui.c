@@ -20,6 +20,7 @@
 #include "ui.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "font.h"
 #include "palette.h"
@@ -28,10 +29,11 @@
 #include "tname.h"
 #include "assets.h"
 #include "input.h"
+#include "framebuffer.h"
+#include "text.h"
+#include "frame.h"
+#include "tile.h"
 
-void drawFillRect(int x1, int y1, int x2, int y2, char r, char g, char b, char a);
-void drawPixel(int x, int y, char r, char g, char b, char a);
-void fillScreen(char r, char g, char b, char a);
 void render_set_target(ui_render_target* target);
 
 int inventory_scroll = 0;
@@ -60,63 +62,87 @@ ui_render_target window_title_target;
 ui_render_target window_content_target;
 ui_render_target game_target;
 
-void ui_get_target_bounds(ui_render_target* target, int* x1, int* y1, int* x2, int* y2)
+//Static window chrome, drawn once and copied in as the frame background
+u32 *ui_chrome = NULL;
+bool ui_chrome_valid = false;
+int ui_chrome_width, ui_chrome_height, ui_chrome_pitch;
+int ui_chrome_scale, ui_chrome_x, ui_chrome_y;
+
+void buffer_render_outdent(ui_render_target* target, int x, int y, int width, int height, u32 highlight, u32 shadow);
+
+ui_render_target *ui_targets[UI_NUM_TARGETS] = {&main_target, &window_target, &window_title_target, &window_content_target, &game_target};
+ui_target_clip ui_target_table[UI_NUM_TARGETS];
+bool ui_targets_valid = false;
+
+void ui_invalidate_targets()
 {
-    ui_render_target* iter = target;
-    
-    // Check cached values
-    u32 c = (target->x | (u64)target->y << 32) ^ (target->w | (u64)target->h << 32);
-    if (target->parent)
-        c ^= target->parent->c;
+    ui_targets_valid = false;
+}
 
-    if (c == target->c)
+//Each target is its parent's origin plus its offset, clipped to its own size and every ancestor's bounds
+static void ui_resolve_targets()
+{
+    for(int i = 0; i < UI_NUM_TARGETS; i++)
     {
-        *x1 = target->cx1;
-        *y1 = target->cy1;
-        if (x2)
-            *x2 = target->cx2;
-        if (y2)
-            *y2 = target->cy2;
-        return;
-    }
-    
-    *x1 = 0;
-    *y1 = 0;
-    
-    int minX = 0;
-    int minY = 0;
+        ui_render_target *target = ui_targets[i];
+        ui_target_clip *resolved = &ui_target_table[i];
 
-    while(iter)
-    {
-        *x1 += iter->x;
-        *y1 += iter->y;
-        
-        if (iter->parent)
+        resolved->x1 = target->x;
+        resolved->y1 = target->y;
+        if(target->parent)
         {
-            int x, y, xMax, yMax;
-            ui_get_target_bounds(iter->parent, &x, &y, &xMax, &yMax);
-            minX = minX ? MIN(minX, xMax) : xMax;
-            minY = minY ? MIN(minY, yMax) : yMax;
+            resolved->x1 += ui_target_table[target->parent->id].x1;
+            resolved->y1 += ui_target_table[target->parent->id].y1;
         }
-        
-        iter = iter->parent;
+
+        resolved->x2 = resolved->x1 + target->w;
+        resolved->y2 = resolved->y1 + target->h;
+        if(target->parent)
+        {
+            resolved->x2 = MIN(resolved->x2, ui_target_table[target->parent->id].x2);
+            resolved->y2 = MIN(resolved->y2, ui_target_table[target->parent->id].y2);
+        }
+
+        resolved->x = resolved->x1 * draw_scale;
+        resolved->y = resolved->y1 * draw_scale;
+        resolved->clip.x1 = resolved->x1 * draw_scale;
+        resolved->clip.y1 = resolved->y1 * draw_scale;
+        resolved->clip.x2 = (resolved->x2 + 1) * draw_scale;
+        resolved->clip.y2 = (resolved->y2 + 1) * draw_scale;
     }
 
-    minX = minX ? MIN(*x1 + target->w, minX) : *x1 + target->w;
-    minY = minY ? MIN(*y1 + target->h, minY) : *y1 + target->h;
+    ui_targets_valid = true;
+}
+
+const ui_target_clip *ui_get_target_clip(ui_render_target* target)
+{
+    if(!ui_targets_valid)
+        ui_resolve_targets();
+
+    return &ui_target_table[target->id];
+}
+
+void ui_get_target_bounds(ui_render_target* target, int* x1, int* y1, int* x2, int* y2)
+{
+    const ui_target_clip *resolved = ui_get_target_clip(target);
 
+    *x1 = resolved->x1;
+    *y1 = resolved->y1;
     if (x2)
-        *x2 = minX;
-    
+        *x2 = resolved->x2;
     if (y2)
-        *y2 = minY;
-    
-    // Store cached values
-    target->c = c;
-    target->cx1 = *x1;
-    target->cy1 = *y1;
-    target->cx2 = minX;
-    target->cy2 = minY;
+        *y2 = resolved->y2;
+}
+
+//Picks up WINDOW_X/Y, only invalidating the table when the window actually moved
+static void ui_move_window()
+{
+    if(window_target.x == WINDOW_X && window_target.y == WINDOW_Y)
+        return;
+
+    window_target.x = WINDOW_X;
+    window_target.y = WINDOW_Y;
+    ui_invalidate_targets();
 }
 
 void ui_render_target_clear(ui_render_target* target, u8 r, u8 g, u8 b, u8 a)
@@ -124,72 +150,141 @@ void ui_render_target_clear(ui_render_target* target, u8 r, u8 g, u8 b, u8 a)
     int x1, x2, y1, y2;
     ui_get_target_bounds(target, &x1, &y1, &x2, &y2);
     
-    drawFillRect(x1 * draw_scale, y1 * draw_scale, x2 * draw_scale, y2 * draw_scale, r, g, b, a);
+    framebuffer_fill_rect(x1 * draw_scale, y1 * draw_scale, (x2 * draw_scale) + 1, (y2 * draw_scale) + 1, FRAMEBUFFER_ARGB(a, r, g, b), NULL);
 }
 
-void buffer_clear_screen(u8 r, u8 g, u8 b, u8 a)
+void ui_invalidate_chrome()
 {
-    fillScreen(0, 0x82, 0x82, 0xff);
+    ui_chrome_valid = false;
+}
 
+//Desktop, window frame, title bar and every bevel, none of which depend on game state
+static void ui_render_chrome()
+{
+    framebuffer_fill(FRAMEBUFFER_ARGB(0xff, 0, 0x82, 0x82));
     ui_render_target_clear(&window_target, 200, 200, 200, 255);
+
+    //Game Surrounding box
+    buffer_render_outdent(&window_content_target, 5, 5, SCREEN_WIDTH+6,SCREEN_HEIGHT+6, 0x808080, 0xFFFFFF);
+    buffer_render_outdent(&window_content_target, 6, 6, SCREEN_WIDTH+4,SCREEN_HEIGHT+4, 0x808080, 0xFFFFFF);
+    buffer_render_outdent(&window_content_target, 7, 7, SCREEN_WIDTH+2,SCREEN_HEIGHT+2, 0x808080, 0xFFFFFF);
+
+    //Surrounding box
+    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 17, 6, 187,228, 0x808080, 0xFFFFFF);
+    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 18, 7, 185,226, 0x808080, 0xFFFFFF);
+
+    //Force box
+    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 17 + 77, 236 + 18, 13,36, 0x808080, 0xFFFFFF);
+    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 17 + 78, 237 + 18, 11,34, 0x808080, 0xFFFFFF);
+    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 17 + 79, 237 + 19, 9,32, 0xFFFFFF, 0x808080);
+
+    //Item box
+    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 16 + 17 + 77, 236 + 18, 36,36, 0x808080, 0xFFFFFF);
+    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 16 + 17 + 78, 237 + 18, 34,34, 0x808080, 0xFFFFFF);
+    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 16 + 17 + 79, 237 + 19, 32,32, 0xFFFFFF, 0x808080);
+
+    //Scroll box
+    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 17 + 190, 6, 20,228, 0x808080, 0xFFFFFF);
+    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 18 + 190, 7, 18,226, 0x808080, 0xFFFFFF);
+
+    for(int i = 0; i < 7; i++)
+    {
+        buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 19, 8 + (i * 32),32,32, 0xFFFFFF, 0x808080);
+        buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 19 + 33, 8 + (i * 32),150,32, 0xFFFFFF, 0x808080);
+    }
+
+    buffer_render_outdent(&window_target, 0, 0, (SCREEN_WIDTH+236)+4, (SCREEN_HEIGHT+16+12)+4, 0xc3c3c3, 0x000000);
+    buffer_render_outdent(&window_target, 1, 1, (SCREEN_WIDTH+236)+2, (SCREEN_HEIGHT+16+12)+2, 0xffffff, 0x828282);
+    ui_render_target_clear(&window_title_target, 0, 0, 0x82, 255);
+}
+
+//The chrome only has to be redrawn when the window moves, the scale changes or the framebuffer is resized
+void buffer_clear_screen(u8 r, u8 g, u8 b, u8 a)
+{
+    if(frame_current)
+        framebuffer_update_palette(frame_current->palette);
+
+    size_t size = framebuffer_pitch * framebuffer_height * sizeof(u32);
+    if(!ui_chrome_valid || ui_chrome_width != framebuffer_width || ui_chrome_height != framebuffer_height || ui_chrome_pitch != framebuffer_pitch
+       || ui_chrome_scale != draw_scale || ui_chrome_x != WINDOW_X || ui_chrome_y != WINDOW_Y)
+    {
+        ui_move_window();
+        ui_render_chrome();
+
+        free(ui_chrome);
+        ui_chrome = malloc(size);
+        if(ui_chrome)
+            memcpy(ui_chrome, framebuffer, size);
+
+        ui_chrome_valid = ui_chrome != NULL;
+        ui_chrome_width = framebuffer_width;
+        ui_chrome_height = framebuffer_height;
+        ui_chrome_pitch = framebuffer_pitch;
+        ui_chrome_scale = draw_scale;
+        ui_chrome_x = WINDOW_X;
+        ui_chrome_y = WINDOW_Y;
+    }
+    else
+    {
+        memcpy(framebuffer, ui_chrome, size);
+    }
+
     ui_render_target_clear(&game_target, r, g, b, a);
 }
 
 void buffer_plot_pixel(ui_render_target* target, int x, int y, u8 r, u8 g, u8 b, u8 a)
-{    
-    int x_shift = 0;
-    int y_shift = 0;
-    
-    int x1, x2, y1, y2;
-    ui_get_target_bounds(target, &x1, &y1, &x2, &y2);
-    
-    if (!CONTAINED_2D(x+x1+1,y+y1+1, x1, y1, x2+2, y2+2))
+{
+    const ui_target_clip *resolved = ui_get_target_clip(target);
+
+    framebuffer_fill_rect((x*draw_scale)+resolved->x, (y*draw_scale)+resolved->y, ((x+1)*draw_scale)+resolved->x, ((y+1)*draw_scale)+resolved->y, FRAMEBUFFER_ARGB(a, r, g, b), &resolved->clip);
+}
+
+void buffer_fill_rect(ui_render_target* target, int x1, int y1, int x2, int y2, u8 r, u8 g, u8 b, u8 a)
+{
+    const ui_target_clip *resolved = ui_get_target_clip(target);
+
+    framebuffer_fill_rect((x1*draw_scale)+resolved->x, (y1*draw_scale)+resolved->y, (x2*draw_scale)+resolved->x, (y2*draw_scale)+resolved->y, FRAMEBUFFER_ARGB(a, r, g, b), &resolved->clip);
+}
+
+void buffer_resolve_indexed(ui_render_target* target)
+{
+    const ui_target_clip *resolved = ui_get_target_clip(target);
+
+    framebuffer_resolve_indexed(resolved->x, resolved->y, draw_scale, &resolved->clip);
+}
+
+void buffer_render_texture(ui_render_target* target, int x, int y, int width, int height, u8 alpha, void *buffer)
+{
+    if(!buffer || buffer == (void*)-1)
         return;
-    
-    x_shift = x1 * draw_scale;
-    y_shift = y1 * draw_scale;
-    
-    drawFillRect((x*draw_scale)+x_shift,(y*draw_scale)+y_shift,(x*draw_scale)+x_shift+(draw_scale-1),(y*draw_scale)+y_shift+(draw_scale-1),r,g,b,a);
+
+    const ui_target_clip *resolved = ui_get_target_clip(target);
+
+    framebuffer_blit_indexed((x*draw_scale)+resolved->x, (y*draw_scale)+resolved->y, width, height, draw_scale, buffer, alpha, &resolved->clip);
 }
 
 
-int buffer_render_char(ui_render_target* target, int x, int y, char c)
+//Draws a laid out string in one mask blit
+void buffer_render_layout(ui_render_target* target, int x, int y, text_layout *layout, u8 r, u8 g, u8 b, u8 a)
 {
-    if(c == ' ')
-        return deskAdvInvFontInfo.space_width+1;
+    const ui_target_clip *resolved = ui_get_target_clip(target);
 
-    int offset = deskAdvInvFontDescriptors[c-deskAdvInvFontInfo.start_char].offset;
-    for(int i = 0; i < deskAdvInvFontDescriptors[c-deskAdvInvFontInfo.start_char].width; i++)
-    {
-        for(int j = 0; j < DESKADV_INV_FONT_HEIGHT; j++)
-        {
-            if(deskAdvInvFontBitmaps[offset+j] & (1<<(7-i)))
-                buffer_plot_pixel(target, x+i,y+j,0,0,0,255);
-        }
-    }
-    return deskAdvInvFontDescriptors[c-deskAdvInvFontInfo.start_char].width+1;
+    framebuffer_blit_mask((x*draw_scale)+resolved->x, (y*draw_scale)+resolved->y, layout->width, layout->height, draw_scale, layout->mask, FRAMEBUFFER_ARGB(a, r, g, b), &resolved->clip);
 }
 
+//Inventory labels are laid out once and kept in the text cache as ready-made surfaces
 void buffer_render_text(ui_render_target* target, int x, int y, char *text)
 {
-    for(int i = 0; i < strlen(text); i++)
-    {
-        x += buffer_render_char(target, x,y,text[i]);
-    }
+    buffer_render_layout(target, x, y, text_layout_get(TEXT_FONT_INVENTORY, text, 0), 0, 0, 0, 255);
 }
 
 void buffer_draw_line(ui_render_target* target, int x1, int y1, int x2, int y2, char r, char g, char b, char a)
 {
 
-	int x, y;
-	if (x1 == x2){
-		if (y1 < y2) for (y = y1; y <= y2; y++) buffer_plot_pixel(target, x1, y, r, g, b, a);
-		else for (y = y2; y <= y1; y++) buffer_plot_pixel(target, x1, y, r, g, b, a);
-	}
-	else {
-		if (x1 < x2) for (x = x1; x <= x2; x++) buffer_plot_pixel(target, x, y1, r, g, b, a);
-		else for (x = x2; x <= x1; x++) buffer_plot_pixel(target, x, y1, r, g, b, a);
-	}
+	if (x1 == x2)
+		buffer_fill_rect(target, x1, MIN(y1, y2), x1 + 1, MAX(y1, y2) + 1, r, g, b, a);
+	else
+		buffer_fill_rect(target, MIN(x1, x2), y1, MAX(x1, x2) + 1, y1 + 1, r, g, b, a);
 }
 
 void buffer_render_outdent(ui_render_target* target, int x, int y, int width, int height, u32 highlight, u32 shadow)
@@ -215,39 +310,29 @@ void buffer_render_outdent(ui_render_target* target, int x, int y, int width, in
 
 void buffer_render_tile(ui_render_target* target, int x, int y, u8 alpha, u32 tile)
 {
-    int width = 32, height = 32;
-    void *buffer = texture_buffers[tile];
-
-    if(!buffer || buffer == -1)
+    if(tile >= 0x2001)
         return;
 
-    for(int i = 0; i < width*height; i++)
+    if(!texture_spans[tile])
     {
-        u8 index = *(u8*)(buffer+i);
-        u8 r,g,b;
+        buffer_render_texture(target, x, y, 32, 32, alpha, texture_buffers[tile]);
+        return;
+    }
 
-        if(!index)
-            continue;
+    const ui_target_clip *resolved = ui_get_target_clip(target);
 
-        if(is_yoda)
-        {
-            b = (u8) (yodesk_palette[(index * 4)]);
-            g = (u8) (yodesk_palette[(index * 4) + 1]);
-            r = (u8) (yodesk_palette[(index * 4) + 2]);
-        }
-        else
-        {
-            b = (u8) (indy_palette[(index * 4)]);
-            g = (u8) (indy_palette[(index * 4) + 1]);
-            r = (u8) (indy_palette[(index * 4) + 2]);
-        }
-
-        buffer_plot_pixel(target, x+(i%width),y+(i/height),r,g,b,alpha);
-    }
+    framebuffer_blit_spans((x*draw_scale)+resolved->x, (y*draw_scale)+resolved->y, draw_scale, texture_spans[tile], texture_buffers[tile], alpha, &resolved->clip);
 }
 
 void ui_init(int x, int y, int w, int h, bool windowOnly)
 {
+    text_init();
+    ui_invalidate_chrome();
+    ui_invalidate_targets();
+
+    for(int i = 0; i < UI_NUM_TARGETS; i++)
+        ui_targets[i]->id = i;
+
     main_target.x = x;
     main_target.y = y;
     main_target.w = w;
@@ -292,8 +377,7 @@ void ui_init(int x, int y, int w, int h, bool windowOnly)
 
 void ui_update()
 {
-    window_target.x = WINDOW_X;
-    window_target.y = WINDOW_Y;
+    ui_move_window();
     
     // Window movement
     int windowTitleX = (WINDOW_X+3);
@@ -387,61 +471,34 @@ void ui_update()
     }
 }
 
+//Only what changes with game state is drawn here, the chrome comes from buffer_clear_screen
 void ui_render()
 {
-    //Game Surrounding box
-    buffer_render_outdent(&window_content_target, 5, 5, SCREEN_WIDTH+6,SCREEN_HEIGHT+6, 0x808080, 0xFFFFFF);
-    buffer_render_outdent(&window_content_target, 6, 6, SCREEN_WIDTH+4,SCREEN_HEIGHT+4, 0x808080, 0xFFFFFF);
-    buffer_render_outdent(&window_content_target, 7, 7, SCREEN_WIDTH+2,SCREEN_HEIGHT+2, 0x808080, 0xFFFFFF);
-
-    //Surrounding box
-    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 17, 6, 187,228, 0x808080, 0xFFFFFF);
-    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 18, 7, 185,226, 0x808080, 0xFFFFFF);
-
-    //Force box
-    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 17 + 77, 236 + 18, 13,36, 0x808080, 0xFFFFFF);
-    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 17 + 78, 237 + 18, 11,34, 0x808080, 0xFFFFFF);
-    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 17 + 79, 237 + 19, 9,32, 0xFFFFFF, 0x808080);
-
-    //Item box
-    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 16 + 17 + 77, 236 + 18, 36,36, 0x808080, 0xFFFFFF);
-    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 16 + 17 + 78, 237 + 18, 34,34, 0x808080, 0xFFFFFF);
-    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 16 + 17 + 79, 237 + 19, 32,32, 0xFFFFFF, 0x808080);
-    if(PLAYER_EQUIPPED_ITEM != 0xFFFF)
-    {
-        buffer_render_tile(&window_content_target, SCREEN_WIDTH + 16 + 17 + 79, 237 + 19, 255, player_inventory[PLAYER_EQUIPPED_ITEM]);
-    }
-
-    //Scroll box
-    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 17 + 190, 6, 20,228, 0x808080, 0xFFFFFF);
-    buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 18 + 190, 7, 18,226, 0x808080, 0xFFFFFF);
+    const screen_frame *frame = frame_current;
+    if(!frame || !frame->has_inventory)
+        return;
 
-    for(int i = 0; i < 7; i++)
+    if(frame->equipped_item != 0xFFFF)
     {
-        buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 19, 8 + (i * 32),32,32, 0xFFFFFF, 0x808080);
-        buffer_render_outdent(&window_content_target, SCREEN_WIDTH + 19 + 33, 8 + (i * 32),150,32, 0xFFFFFF, 0x808080);
+        buffer_render_tile(&window_content_target, SCREEN_WIDTH + 16 + 17 + 79, 237 + 19, 255, frame->inventory[frame->equipped_item & 0xFF]);
     }
 
-    for(int i = 0; i < 7; i++)
+    for(int i = 0; i < 7 && i+inventory_scroll < 0x100; i++)
     {
-        if(!player_inventory) break;
-        if(player_inventory[i+inventory_scroll] == 0) break;
+        u16 item = frame->inventory[i+inventory_scroll];
+        if(item == 0) break;
 
         int item_render_x = SCREEN_WIDTH + 19;
         int item_render_y = 8 + (i * 32);
         if(CURRENT_ITEM_DRAGGED != i+inventory_scroll)
-            buffer_render_tile(&window_content_target, item_render_x, item_render_y, 255, player_inventory[i+inventory_scroll]);
+            buffer_render_tile(&window_content_target, item_render_x, item_render_y, 255, item);
 
-        buffer_render_text(&window_content_target, SCREEN_WIDTH + 19 + 32 + 10, 8 + (i * 32) + ((32/2) - deskAdvInvFontInfo.height/2), tile_names[player_inventory[i+inventory_scroll]]);
+        buffer_render_text(&window_content_target, SCREEN_WIDTH + 19 + 32 + 10, 8 + (i * 32) + ((32/2) - deskAdvInvFontInfo.height/2), tile_names[item]);
     }
-    
-    buffer_render_outdent(&window_target, 0, 0, (SCREEN_WIDTH+236)+4, (SCREEN_HEIGHT+16+12)+4, 0xc3c3c3, 0x000000);
-    buffer_render_outdent(&window_target, 1, 1, (SCREEN_WIDTH+236)+2, (SCREEN_HEIGHT+16+12)+2, 0xffffff, 0x828282);
-    ui_render_target_clear(&window_title_target, 0, 0, 0x82, 255);
 
     if(CURRENT_ITEM_DRAGGED != -1)
     {
-        buffer_render_tile(&main_target, ABS_MOUSE_X - 16, ABS_MOUSE_Y - 16, 255, player_inventory[CURRENT_ITEM_DRAGGED]);
+        buffer_render_tile(&main_target, ABS_MOUSE_X - 16, ABS_MOUSE_Y - 16, 255, frame->inventory[CURRENT_ITEM_DRAGGED & 0xFF]);
     }
     else
     {
@@ -466,6 +523,54 @@ void ui_render()
     }
 }
 
+static u32 ui_key_mix(u32 key, u32 value)
+{
+    return (key ^ value) * 0x01000193;
+}
+
+//Folds in the UI's own state, the inventory itself comes with each frame
+u32 ui_frame_key()
+{
+    u32 key = 0x811C9DC5;
+    key = ui_key_mix(key, WINDOW_X);
+    key = ui_key_mix(key, WINDOW_Y);
+    key = ui_key_mix(key, draw_scale);
+    key = ui_key_mix(key, inventory_scroll);
+    key = ui_key_mix(key, CURRENT_ITEM_DRAGGED);
+    key = ui_key_mix(key, PLAYER_EQUIPPED_ITEM);
+
+    //The dragged item follows the mouse
+    if(CURRENT_ITEM_DRAGGED != -1)
+    {
+        key = ui_key_mix(key, ABS_MOUSE_X);
+        key = ui_key_mix(key, ABS_MOUSE_Y);
+    }
+
+    return key;
+}
+
+//Whether an item on show uses any of the given PALETTE_ANIM_* groups
+bool ui_uses_palette(u8 mask)
+{
+    if(!player_inventory)
+        return false;
+
+    if(PLAYER_EQUIPPED_ITEM != 0xFFFF && player_inventory[PLAYER_EQUIPPED_ITEM] < 0x2000
+       && (tile_palette_anim[player_inventory[PLAYER_EQUIPPED_ITEM]] & mask))
+        return true;
+
+    for(int i = 0; i < 7; i++)
+    {
+        u16 item = player_inventory[i+inventory_scroll];
+        if(item == 0) break;
+
+        if(item < 0x2000 && (tile_palette_anim[item] & mask))
+            return true;
+    }
+
+    return false;
+}
+
 void ui_set_mouse_abs(int x, int y)
 {
     ABS_MOUSE_X = x / draw_scale;
@@ -502,7 +607,31 @@ void ui_touch_up()
     TOUCH_HELD = false;
 }
 
+//Everything the platform fed in since the last ui_update, so replay.c can record and restore it
+u8 ui_get_pointer(int *x, int *y)
+{
+    *x = ABS_MOUSE_X;
+    *y = ABS_MOUSE_Y;
+
+    return (MOUSE_HELD_LEFT ? UI_POINTER_HELD_LEFT : 0) | (MOUSE_DOWN_LEFT ? UI_POINTER_DOWN_LEFT : 0)
+           | (TOUCH_HELD ? UI_POINTER_TOUCH_HELD : 0) | (TOUCH_DOWN ? UI_POINTER_TOUCH_DOWN : 0)
+           | (TOUCH_UP ? UI_POINTER_TOUCH_UP : 0);
+}
+
+void ui_set_pointer(int x, int y, u8 flags)
+{
+    ABS_MOUSE_X = x;
+    ABS_MOUSE_Y = y;
+    MOUSE_HELD_LEFT = (flags & UI_POINTER_HELD_LEFT) != 0;
+    MOUSE_DOWN_LEFT = (flags & UI_POINTER_DOWN_LEFT) != 0;
+    TOUCH_HELD = (flags & UI_POINTER_TOUCH_HELD) != 0;
+    TOUCH_DOWN = (flags & UI_POINTER_TOUCH_DOWN) != 0;
+    TOUCH_UP = (flags & UI_POINTER_TOUCH_UP) != 0;
+}
+
 void ui_set_draw_scale(int scale)
 {
     draw_scale = scale;
+    ui_invalidate_chrome();
+    ui_invalidate_targets();
 }
@@ -0,0 +1,277 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "upscale.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "blit.h"
+
+#if defined(BLIT_AVX2) || defined(BLIT_SSE2)
+#include <emmintrin.h>
+#elif defined(BLIT_NEON)
+#include <arm_neon.h>
+#endif
+
+u8 upscale_filter = UPSCALE_NEAREST;
+const char *upscale_filter_names[UPSCALE_NUM_FILTERS] = {"nearest", "scalenx", "xbr-lite"};
+
+//Intermediate 2x image for the 4x filters
+u8 *upscale_temp = NULL;
+u32 upscale_temp_size = 0;
+
+void upscale_cycle_filter()
+{
+    upscale_filter = (upscale_filter + 1) % UPSCALE_NUM_FILTERS;
+}
+
+bool upscale_filter_supports(u8 filter, int scale)
+{
+    switch(filter)
+    {
+        case UPSCALE_NEAREST:
+            return scale >= 1;
+        case UPSCALE_SCALENX:
+            return scale >= 2 && scale <= 4;
+        case UPSCALE_XBR_LITE:
+            return scale == 2 || scale == 4;
+    }
+    return false;
+}
+
+void upscale_nearest_row(u32 *dst, const u8 *src, int count, int scale, const u32 *lut)
+{
+    int i = 0;
+
+#if defined(BLIT_AVX2) || defined(BLIT_SSE2)
+    if(scale == 2)
+    {
+        for(; i + 4 <= count; i += 4, dst += 8)
+        {
+            __m128i color = _mm_set_epi32(lut[src[i + 3]], lut[src[i + 2]], lut[src[i + 1]], lut[src[i]]);
+            _mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi32(color, color));
+            _mm_storeu_si128((__m128i*)(dst + 4), _mm_unpackhi_epi32(color, color));
+        }
+    }
+    else if(scale == 4)
+    {
+        for(; i < count; i++, dst += 4)
+            _mm_storeu_si128((__m128i*)dst, _mm_set1_epi32(lut[src[i]]));
+    }
+#elif defined(BLIT_NEON)
+    if(scale == 2)
+    {
+        for(; i + 4 <= count; i += 4, dst += 8)
+        {
+            u32 colors[4] = {lut[src[i]], lut[src[i + 1]], lut[src[i + 2]], lut[src[i + 3]]};
+            uint32x4_t color = vld1q_u32(colors);
+            vst2q_u32(dst, (uint32x4x2_t){{color, color}});
+        }
+    }
+    else if(scale == 4)
+    {
+        for(; i < count; i++, dst += 4)
+            vst1q_u32(dst, vdupq_n_u32(lut[src[i]]));
+    }
+#endif
+
+    for(; i < count; i++)
+    {
+        u32 color = lut[src[i]];
+        for(int j = 0; j < scale; j++)
+            *dst++ = color;
+    }
+}
+
+static void upscale_scale2x(u8 *dst, const u8 *src, int width, int height)
+{
+    int pitch = width * 2;
+    for(int y = 0; y < height; y++)
+    {
+        const u8 *row = src + (y * width);
+        const u8 *above = y > 0 ? row - width : row;
+        const u8 *below = y < height - 1 ? row + width : row;
+        u8 *out = dst + (y * 2 * pitch);
+
+        for(int x = 0; x < width; x++)
+        {
+            u8 b = above[x], h = below[x], e = row[x];
+            u8 d = x > 0 ? row[x - 1] : e;
+            u8 f = x < width - 1 ? row[x + 1] : e;
+
+            if(b != h && d != f)
+            {
+                out[(x * 2)] = d == b ? d : e;
+                out[(x * 2) + 1] = b == f ? f : e;
+                out[pitch + (x * 2)] = d == h ? d : e;
+                out[pitch + (x * 2) + 1] = h == f ? f : e;
+            }
+            else
+            {
+                out[(x * 2)] = out[(x * 2) + 1] = out[pitch + (x * 2)] = out[pitch + (x * 2) + 1] = e;
+            }
+        }
+    }
+}
+
+static void upscale_scale3x(u8 *dst, const u8 *src, int width, int height)
+{
+    int pitch = width * 3;
+    for(int y = 0; y < height; y++)
+    {
+        const u8 *row = src + (y * width);
+        const u8 *above = y > 0 ? row - width : row;
+        const u8 *below = y < height - 1 ? row + width : row;
+        u8 *out = dst + (y * 3 * pitch);
+
+        for(int x = 0; x < width; x++)
+        {
+            int l = x > 0 ? x - 1 : x, r = x < width - 1 ? x + 1 : x;
+            u8 a = above[l], b = above[x], c = above[r];
+            u8 d = row[l], e = row[x], f = row[r];
+            u8 g = below[l], h = below[x], i = below[r];
+            u8 *o = out + (x * 3);
+
+            if(b != h && d != f)
+            {
+                o[0] = d == b ? d : e;
+                o[1] = (d == b && e != c) || (b == f && e != a) ? b : e;
+                o[2] = b == f ? f : e;
+                o[pitch] = (d == b && e != g) || (d == h && e != a) ? d : e;
+                o[pitch + 1] = e;
+                o[pitch + 2] = (b == f && e != i) || (h == f && e != c) ? f : e;
+                o[(pitch * 2)] = d == h ? d : e;
+                o[(pitch * 2) + 1] = (d == h && e != i) || (h == f && e != g) ? h : e;
+                o[(pitch * 2) + 2] = h == f ? f : e;
+            }
+            else
+            {
+                for(int j = 0; j < 3; j++)
+                    memset(o + (pitch * j), e, 3);
+            }
+        }
+    }
+}
+
+//Weighted RGB distances between every pair of palette entries, for the palette they were built from
+u16 upscale_distances[0x100 * 0x100];
+u32 upscale_distance_palette[0x100];
+bool upscale_distances_built = false;
+
+static void upscale_build_distances(const u32 *lut)
+{
+    if(upscale_distances_built && !memcmp(upscale_distance_palette, lut, sizeof(upscale_distance_palette)))
+        return;
+
+    for(int a = 0; a < 0x100; a++)
+    {
+        for(int b = 0; b < 0x100; b++)
+        {
+            int dr = abs((int)((lut[a] >> 16) & 0xFF) - (int)((lut[b] >> 16) & 0xFF));
+            int dg = abs((int)((lut[a] >> 8) & 0xFF) - (int)((lut[b] >> 8) & 0xFF));
+            int db = abs((int)(lut[a] & 0xFF) - (int)(lut[b] & 0xFF));
+            upscale_distances[(a << 8) | b] = (dr * 2) + (dg * 4) + (db * 3);
+        }
+    }
+
+    memcpy(upscale_distance_palette, lut, sizeof(upscale_distance_palette));
+    upscale_distances_built = true;
+}
+
+static inline int upscale_distance(u8 a, u8 b)
+{
+    return upscale_distances[(a << 8) | b];
+}
+
+/*
+ * One corner of the xBR rule on a 3x3 window, rotated so the corner is the
+ * one between e, f (side) and h (below). If the edge along f-h is weaker
+ * than the one through e-i, the corner takes the closer of f and h.
+ */
+static inline u8 upscale_xbr_corner(u8 e, u8 f, u8 h, u8 i, u8 c, u8 g, u8 b, u8 d)
+{
+    int along = upscale_distance(e, c) + upscale_distance(e, g) + upscale_distance(i, f) + upscale_distance(i, h) + (4 * upscale_distance(h, f));
+    int across = upscale_distance(h, d) + upscale_distance(f, b) + (4 * upscale_distance(e, i));
+
+    if(along >= across)
+        return e;
+
+    return upscale_distance(e, f) <= upscale_distance(e, h) ? f : h;
+}
+
+static void upscale_xbr2x(u8 *dst, const u8 *src, int width, int height, const u32 *lut)
+{
+    upscale_build_distances(lut);
+
+    int pitch = width * 2;
+    for(int y = 0; y < height; y++)
+    {
+        const u8 *row = src + (y * width);
+        const u8 *above = y > 0 ? row - width : row;
+        const u8 *below = y < height - 1 ? row + width : row;
+        u8 *out = dst + (y * 2 * pitch);
+
+        for(int x = 0; x < width; x++)
+        {
+            int l = x > 0 ? x - 1 : x, r = x < width - 1 ? x + 1 : x;
+            u8 a = above[l], b = above[x], c = above[r];
+            u8 d = row[l], e = row[x], f = row[r];
+            u8 g = below[l], h = below[x], i = below[r];
+
+            //Flat areas are most of a frame and can't have an edge to smooth
+            if(b == e && d == e && f == e && h == e)
+            {
+                out[(x * 2)] = out[(x * 2) + 1] = out[pitch + (x * 2)] = out[pitch + (x * 2) + 1] = e;
+                continue;
+            }
+
+            out[(x * 2)] = upscale_xbr_corner(e, d, b, a, g, c, h, f);
+            out[(x * 2) + 1] = upscale_xbr_corner(e, b, f, c, a, i, d, h);
+            out[pitch + (x * 2)] = upscale_xbr_corner(e, h, d, g, i, a, f, b);
+            out[pitch + (x * 2) + 1] = upscale_xbr_corner(e, f, h, i, c, g, b, d);
+        }
+    }
+}
+
+void upscale_filter_indexed(u8 *dst, const u8 *src, int width, int height, int scale, u8 filter, const u32 *lut)
+{
+    if(scale == 4)
+    {
+        u32 size = width * height * 4;
+        if(size > upscale_temp_size)
+        {
+            free(upscale_temp);
+            upscale_temp = malloc(size);
+            upscale_temp_size = size;
+        }
+
+        upscale_filter_indexed(upscale_temp, src, width, height, 2, filter, lut);
+        upscale_filter_indexed(dst, upscale_temp, width * 2, height * 2, 2, filter, lut);
+        return;
+    }
+
+    if(filter == UPSCALE_XBR_LITE && scale == 2)
+        upscale_xbr2x(dst, src, width, height, lut);
+    else if(scale == 3)
+        upscale_scale3x(dst, src, width, height);
+    else
+        upscale_scale2x(dst, src, width, height);
+}
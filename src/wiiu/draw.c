@@ -12,6 +12,9 @@ void *screenBufferTop;
 void *screenBufferBottom;
 int activeScreen = 0;
 
+//OSScreen splits each buffer into two halves and draws into the one not on display
+int backBuffer[2] = {0, 0};
+
 u32 getScreenWidth()
 {
     if(activeScreen == 0)
@@ -28,6 +31,22 @@ u32 getScreenHeight()
         return 480;
 }
 
+//Row pitch in pixels, the gamepad's rows are padded out to 896
+u32 getScreenPitch()
+{
+    if(activeScreen == 0)
+        return 1280;
+    else
+        return 896;
+}
+
+//The half of the active screen's buffer that the next flip shows, as RGBA
+u32 *getScreenBuffer()
+{
+    u8 *buffer = activeScreen == SCREEN_BOTTOM ? screenBufferBottom : screenBufferTop;
+    return (u32*)(buffer + (backBuffer[activeScreen] * (OSScreenGetBufferSizeEx(activeScreen) / 2)));
+}
+
 void setActiveScreen(int screen)
 {
     activeScreen = screen;
@@ -47,6 +66,7 @@ void flipBuffers()
 	
 	//Flip the buffer
 	OSScreenFlipBuffersEx(activeScreen);
+	backBuffer[activeScreen] ^= 1;
 }
 
 void drawOSString(int x, int y, char * string)
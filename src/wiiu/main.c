@@ -8,6 +8,7 @@
 #include <sysapp/launch.h>
 #include <vpad/input.h>
 
+#include <string.h>
 #include <time.h>
 
 #include "draw.h"
@@ -15,6 +16,8 @@
 #include "assets.h"
 #include "screen.h"
 #include "input.h"
+#include "framebuffer.h"
+#include "ui.h"
 #include "map.h"
 
 bool initialized = false;
@@ -144,6 +147,10 @@ main(int argc, char **argv)
     OSSystemInfo *info = OSGetSystemInfo();
     u32 clockSpeed = *(u32*)(info + sizeof(u32));
 
+    //No window chrome here, line the game target up with the framebuffer
+    ui_init(-10, -22, SCREEN_WIDTH+10, SCREEN_HEIGHT+22, false);
+    framebuffer_init(SCREEN_WIDTH, SCREEN_HEIGHT);
+
     chdir("fs:/vol/content/");
     load_resources();
 
@@ -206,38 +213,41 @@ void update_input()
         button_move_down();
 }
 
-void render_flip_buffers()
+//Puts the game framebuffer centered on the active screen at an integer scale
+static void present_screen(int screen, int scale)
 {
-    setActiveScreen(SCREEN_TOP);
-    flipBuffers();
-    setActiveScreen(SCREEN_BOTTOM);
-    flipBuffers();
-}
+    setActiveScreen(screen);
+    u32 *out = getScreenBuffer();
+    u32 pitch = getScreenPitch();
+    int width = MIN(framebuffer_width*scale, (int)getScreenWidth());
+    int height = MIN(framebuffer_height*scale, (int)getScreenHeight());
+    int x_shift = ((int)getScreenWidth() - width) / 2;
+    int y_shift = ((int)getScreenHeight() - height) / 2;
+
+    //Build each scaled row once, the ones repeating it are copies
+    for(int y = 0; y < height; y += scale)
+    {
+        u32 *in = framebuffer + ((y / scale) * framebuffer_pitch);
+        u32 *row = out + ((y + y_shift) * pitch) + x_shift;
 
-void buffer_clear_screen(u8 r, u8 g, u8 b, u8 a)
-{
-    setActiveScreen(SCREEN_TOP);
-    fillScreen(r,g,b,a);
-    setActiveScreen(SCREEN_BOTTOM);
-    fillScreen(r,g,b,a);
+        //The framebuffer is ARGB, OSScreen wants RGBA
+        for(int x = 0; x < width; x++)
+            row[x] = (in[x / scale] << 8) | 0xFF;
+
+        for(int i = 1; i < scale && y + i < height; i++)
+            memcpy(row + (i * pitch), row, width * sizeof(u32));
+    }
 }
 
-void buffer_plot_pixel(int x, int y, u8 r, u8 g, u8 b, u8 a)
+void render_flip_buffers()
 {
-    int scale = 2;
+    present_screen(SCREEN_TOP, 2);
+    present_screen(SCREEN_BOTTOM, 1);
 
     setActiveScreen(SCREEN_TOP);
-    int x_shift = (getScreenWidth() - (288*scale)) / 2;
-    int y_shift = (getScreenHeight() - (288*scale)) / 2;
-    drawFillRect((x*scale)+x_shift,(y*scale)+y_shift,(x*scale)+x_shift+1,(y*scale)+y_shift+1,r,g,b,a);
-
+    flipBuffers();
     setActiveScreen(SCREEN_BOTTOM);
-    scale = 1;
-    x_shift = (getScreenWidth() - (288*scale)) / 2;
-    y_shift = (getScreenHeight() - (288*scale)) / 2;
-    drawFillRect((x*scale)+x_shift,(y*scale)+y_shift,(x*scale)+x_shift+1,(y*scale)+y_shift+1,r,g,b,a);
-
-    setActiveScreen(SCREEN_TOP);
+    flipBuffers();
 }
 
 void render_pre()
@@ -0,0 +1,272 @@
+/*  DesktopAdventures, A reimplementation of the Desktop Adventures game engine
+ *
+ *  DesktopAdventures is the legal property of its developers, whose names
+ *  can be found in the AUTHORS file distributed with this source
+ *  distribution.
+ *
+ *  DesktopAdventures is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "zone.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "assets.h"
+
+//Once the changed cells would take up more than this fraction of a dense
+//copy of all three planes, the dense copy wins.
+#define ZONE_COLLAPSE_DIVISOR (4)
+
+zone_state *zone_states = NULL;
+u16 zone_count = 0;
+
+#ifndef DAT_IN_RAM
+//Without the DAT in memory every peek is a seek and a read, so the planes
+//of the zone in use are read in one go and looked up from here
+u16 *zone_original = NULL;
+u32 zone_original_offset = 0;
+u32 zone_original_count = 0;
+u32 zone_original_capacity = 0;
+
+static const u16 *zone_original_planes(zone_state *zone)
+{
+    u32 count = zone->width * zone->height * ZONE_NUM_PLANES;
+    if(zone_original && zone_original_offset == zone->tiles_offset && zone_original_count == count)
+        return zone_original;
+
+    if(count > zone_original_capacity)
+    {
+        zone_original = realloc(zone_original, count * sizeof(u16));
+        zone_original_capacity = count;
+    }
+
+    u32 orig_seek = get_location();
+    seek(zone->tiles_offset);
+    read_bytes(zone_original, count * sizeof(u16));
+    seek(orig_seek);
+
+#if BIG_ENDIAN && !LITTLE_ENDIAN
+    for(u32 i = 0; i < count; i++)
+        zone_original[i] = (u16)((zone_original[i] & 0xFF00) >> 8) | ((zone_original[i] & 0xFF) << 8);
+#endif
+
+    zone_original_offset = zone->tiles_offset;
+    zone_original_count = count;
+    return zone_original;
+}
+#endif
+
+void zone_init(u16 num_zones)
+{
+    zone_states = calloc(num_zones, sizeof(zone_state));
+    zone_count = num_zones;
+}
+
+zone_state *zone_get(u16 zone_id)
+{
+    return &zone_states[zone_id];
+}
+
+void zone_reset(zone_state *zone)
+{
+    if(!(zone->borrowed & ZONE_BORROWED_DELTA))
+        free(zone->delta);
+    if(!(zone->borrowed & ZONE_BORROWED_DENSE))
+        free(zone->dense);
+
+    zone->delta = NULL;
+    zone->delta_count = 0;
+    zone->delta_capacity = 0;
+    zone->dense = NULL;
+    zone->visited = false;
+    zone->borrowed = 0;
+}
+
+//Index of the first entry whose key is not less than the one given
+static u32 zone_delta_find(zone_state *zone, u32 key)
+{
+    u32 low = 0;
+    u32 high = zone->delta_count;
+    while(low < high)
+    {
+        u32 mid = (low + high) / 2;
+        if(zone->delta[mid].key < key)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+bool zone_get_delta(zone_state *zone, u32 key, u16 *value)
+{
+    if(!zone->delta_count)
+        return false;
+
+    u32 index = zone_delta_find(zone, key);
+    if(index >= zone->delta_count || zone->delta[index].key != key)
+        return false;
+
+    *value = zone->delta[index].value;
+    return true;
+}
+
+void zone_set_delta(zone_state *zone, u32 key, u16 value)
+{
+    u32 index = zone_delta_find(zone, key);
+    if(index < zone->delta_count && zone->delta[index].key == key)
+    {
+        zone->delta[index].value = value;
+        return;
+    }
+
+    if(zone->delta_count == zone->delta_capacity)
+    {
+        zone->delta_capacity = zone->delta_capacity ? zone->delta_capacity * 2 : 8;
+        if(zone->borrowed & ZONE_BORROWED_DELTA)
+        {
+            //Copy out of the save state before growing
+            zone_delta *delta = malloc(zone->delta_capacity * sizeof(zone_delta));
+            memcpy(delta, zone->delta, zone->delta_count * sizeof(zone_delta));
+            zone->delta = delta;
+            zone->borrowed &= ~ZONE_BORROWED_DELTA;
+        }
+        else
+            zone->delta = realloc(zone->delta, zone->delta_capacity * sizeof(zone_delta));
+    }
+
+    memmove(&zone->delta[index+1], &zone->delta[index], (zone->delta_count - index) * sizeof(zone_delta));
+    zone->delta[index].key = key;
+    zone->delta[index].value = value;
+    zone->delta[index].pad = 0;
+    zone->delta_count++;
+}
+
+void zone_clear_delta(zone_state *zone, u32 key)
+{
+    if(!zone->delta_count)
+        return;
+
+    u32 index = zone_delta_find(zone, key);
+    if(index >= zone->delta_count || zone->delta[index].key != key)
+        return;
+
+    memmove(&zone->delta[index], &zone->delta[index+1], (zone->delta_count - index - 1) * sizeof(zone_delta));
+    zone->delta_count--;
+}
+
+u16 zone_get_original_tile(zone_state *zone, u8 layer, u32 cell)
+{
+#ifdef DAT_IN_RAM
+    return peek_short(zone->tiles_offset + (((cell * ZONE_NUM_PLANES) + layer) * sizeof(u16)));
+#else
+    return zone_original_planes(zone)[(cell * ZONE_NUM_PLANES) + layer];
+#endif
+}
+
+u16 zone_get_tile(zone_state *zone, u8 layer, u32 cell)
+{
+    if(zone->dense)
+        return zone->dense[(cell * ZONE_NUM_PLANES) + layer];
+
+    u16 tile;
+    if(zone_get_delta(zone, ZONE_DELTA_KEY(layer, cell), &tile))
+        return tile;
+
+    return zone_get_original_tile(zone, layer, cell);
+}
+
+void zone_set_tile(zone_state *zone, u8 layer, u32 cell, u16 tile)
+{
+    if(zone->dense)
+    {
+        zone->dense[(cell * ZONE_NUM_PLANES) + layer] = tile;
+        return;
+    }
+
+    if(zone_get_original_tile(zone, layer, cell) == tile)
+    {
+        zone_clear_delta(zone, ZONE_DELTA_KEY(layer, cell));
+        return;
+    }
+
+    zone_set_delta(zone, ZONE_DELTA_KEY(layer, cell), tile);
+
+    u32 dense_size = zone->width * zone->height * ZONE_NUM_PLANES * sizeof(u16);
+    if(zone->delta_count * sizeof(zone_delta) > dense_size / ZONE_COLLAPSE_DIVISOR)
+        zone_collapse(zone);
+}
+
+void zone_collapse(zone_state *zone)
+{
+    if(zone->dense)
+        return;
+
+    u32 num_cells = zone->width * zone->height;
+    zone->dense = malloc(num_cells * ZONE_NUM_PLANES * sizeof(u16));
+#ifdef DAT_IN_RAM
+    for(u32 i = 0; i < num_cells * ZONE_NUM_PLANES; i++)
+        zone->dense[i] = peek_short(zone->tiles_offset + (i * sizeof(u16)));
+#else
+    memcpy(zone->dense, zone_original_planes(zone), num_cells * ZONE_NUM_PLANES * sizeof(u16));
+#endif
+
+    //Fold tile changes into the dense planes, keep everything else sparse
+    u32 kept = 0;
+    for(u32 i = 0; i < zone->delta_count; i++)
+    {
+        u32 kind = ZONE_DELTA_KIND_OF(zone->delta[i].key);
+        if(kind < ZONE_NUM_PLANES)
+            zone->dense[(ZONE_DELTA_INDEX_OF(zone->delta[i].key) * ZONE_NUM_PLANES) + kind] = zone->delta[i].value;
+        else
+            zone->delta[kept++] = zone->delta[i];
+    }
+    zone->delta_count = kept;
+}
+
+void zone_load_objects(zone_state *zone, obj_info *objects)
+{
+    u32 location = zone->objects_offset;
+    for(int i = 0; i < zone->num_objects; i++)
+    {
+        objects[i].type = peek_long(location);
+        objects[i].x = peek_short(location + 4);
+        objects[i].y = peek_short(location + 6);
+        objects[i].visible = peek_short(location + 8);
+        objects[i].arg = peek_short(location + 10);
+        location += 0xC;
+
+        zone_get_delta(zone, ZONE_DELTA_KEY(ZONE_DELTA_OBJECT_VISIBLE, i), &objects[i].visible);
+        zone_get_delta(zone, ZONE_DELTA_KEY(ZONE_DELTA_OBJECT_ARG, i), &objects[i].arg);
+    }
+}
+
+void zone_store_objects(zone_state *zone, obj_info *objects)
+{
+    u32 location = zone->objects_offset;
+    for(int i = 0; i < zone->num_objects; i++)
+    {
+        if(objects[i].visible != peek_short(location + 8))
+            zone_set_delta(zone, ZONE_DELTA_KEY(ZONE_DELTA_OBJECT_VISIBLE, i), objects[i].visible);
+        else
+            zone_clear_delta(zone, ZONE_DELTA_KEY(ZONE_DELTA_OBJECT_VISIBLE, i));
+
+        if(objects[i].arg != peek_short(location + 10))
+            zone_set_delta(zone, ZONE_DELTA_KEY(ZONE_DELTA_OBJECT_ARG, i), objects[i].arg);
+        else
+            zone_clear_delta(zone, ZONE_DELTA_KEY(ZONE_DELTA_OBJECT_ARG, i));
+
+        location += 0xC;
+    }
+}